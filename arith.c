@@ -0,0 +1,1152 @@
+/*
+ * Arithmetic coding routines for the gifshuffle steganography program.
+ * Each bit of the message is coded by a binary arithmetic coder, using
+ * a probability from an adaptive model of the bytes. Settled bits are
+ * collected, and passed on a 64-bit word at a time.
+ * The end of the message is marked by a flag coded before each byte.
+ *
+ * Two models are provided. The order-0 model predicts each byte from
+ * the bytes seen so far. The context-mixing model also predicts it
+ * from the bytes seen after the previous byte, and from each of the
+ * built-in Huffman tables, and mixes these predictions, learning which
+ * to trust as it goes. The Huffman tables give it a head start on the
+ * short messages that a colourmap can hold.
+ *
+ * The dictionary method codes the message as literal bytes and matches,
+ * which copy text from earlier in the message, or from a preset
+ * dictionary treated as coming before it. Literals are coded with the
+ * context-mixing model, trained on the dictionary first.
+ */
+
+#include "gifshuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (unix) || defined (__unix__)
+#include <pthread.h>
+#define ARITH_ONCE
+#endif
+
+
+/*
+ * Probabilities are 16-bit fractions. Each adapts at a rate of
+ * 1/(n+2) after n updates, so that short messages are learnt quickly,
+ * until n reaches PROB_LIMIT and the rate becomes fixed.
+ */
+
+#define PROB_BITS	16
+#define PROB_HALF	(1 << (PROB_BITS - 1))
+#define PROB_MIN	32
+#define PROB_MAX	((1 << PROB_BITS) - PROB_MIN)
+#define PROB_LIMIT	30
+
+typedef struct {
+	uint16_t	pr_p1;		/* Probability of a 1 */
+	uint8_t		pr_n;		/* Number of updates */
+} PROB;
+
+
+/*
+ * The mixer works on probabilities stretched into the logistic domain,
+ * ln(p/(1-p)), with 8 fractional bits, between -2047 and 2047.
+ * Its weights have 16 fractional bits, and are kept within MIX_LIMIT,
+ * so that a long run of one bit cannot grow them without bound.
+ * Its inputs are the order-0 and order-1 predictions, a bias, and the
+ * prediction of each Huffman table.
+ * All the arithmetic is in integers, with products formed in 64 bits
+ * and shifted by shift_down(), so that the encoder and decoder agree
+ * exactly on every machine.
+ */
+
+#define MIX_INPUTS	(3 + HUFF_TABLES)
+#define MIX_ONE		65536
+#define MIX_LIMIT	(16 * MIX_ONE)
+#define MIX_RATE	10
+
+#define STRETCH_BITS	12
+
+
+/*
+ * The table of stretched probabilities, and the stretched predictions
+ * of the Huffman tables. They never change, so one copy is built, the
+ * first time any context needs it, and shared by them all.
+ */
+
+typedef struct {
+	short		at_stretch[1 << STRETCH_BITS];
+	short		at_prior[HUFF_TABLES][256];
+} ARITH_TABLES;
+
+static ARITH_TABLES	arith_tables;
+
+#ifdef ARITH_ONCE
+static pthread_once_t	arith_tables_once = PTHREAD_ONCE_INIT;
+#else
+static BOOL		arith_tables_built = FALSE;
+#endif
+
+
+/*
+ * Limits of the dictionary method. Matches are found by searching the
+ * whole window, which is fast enough for messages that a colourmap
+ * can hold.
+ */
+
+#define LZ_MIN_MATCH	3
+#define LZ_MAX_MATCH	256
+#define LZ_MAX_BYTES	4096
+#define LZ_GAMMA_BITS	16		/* Longest number coded */
+
+
+/*
+ * The adaptive model. Each byte is coded as 8 bits down a binary tree,
+ * whose nodes 1-255 each hold a probability. The context-mixing model
+ * keeps a second tree for each value of the previous byte, which is
+ * a fixed 256 Kbytes or so.
+ */
+
+typedef struct {
+	const ARITH_TABLES	*am_tables;
+	BOOL		am_mixed;	/* Context mixing is used */
+	int		am_prev;	/* The previous byte */
+	PROB		am_more;	/* Another byte follows */
+	PROB		am_tree[256];
+	PROB		am_order1[256][256];
+	int		am_weights[MIX_INPUTS];
+	int		am_inputs[MIX_INPUTS];
+	int		am_p;		/* The last mixed prediction */
+} ARITH_MODEL;
+
+
+/*
+ * The model of the match lengths and distances of the dictionary method.
+ * Numbers are coded with an adaptive Elias gamma code: the number of
+ * bits in unary, then the bits after the leading 1.
+ */
+
+typedef struct {
+	PROB		gm_size[LZ_GAMMA_BITS];
+	PROB		gm_bits[LZ_GAMMA_BITS][LZ_GAMMA_BITS];
+} GAMMA_MODEL;
+
+typedef struct {
+	PROB		lm_match[2];	/* By whether the last was a match */
+	int		lm_last_match;
+	GAMMA_MODEL	lm_length;
+	GAMMA_MODEL	lm_distance;
+} LZ_MODEL;
+
+
+/*
+ * State of the binary arithmetic coder. The interval [x1, x2] shrinks
+ * with each bit coded, and its leading bits are shifted out once
+ * x1 and x2 agree on them.
+ */
+
+typedef struct {
+	uint32_t	ac_x1;
+	uint32_t	ac_x2;
+	uint32_t	ac_x;		/* Decoder only */
+	const uint64_t	*ac_in;		/* Decoder only */
+	int		ac_in_bits;
+	int		ac_in_pos;
+	int		ac_out_bits;	/* Encoder only */
+	uint64_t	ac_out_word;	/* Bits not yet output */
+	int		ac_out_pending;
+	ARITH_OUTPUT	ac_output;
+	CONTEXT		*ac_ctx;
+	FILE		*ac_inf;
+	FILE		*ac_outf;
+} ARITH_CODER;
+
+
+/*
+ * The state used for encoding and decoding in a context.
+ * The models are too big to put on the stack.
+ */
+
+struct arith_state_struct {
+	ARITH_MODEL	as_model;
+	ARITH_CODER	as_coder;
+	ARITH_MODEL	as_decode_model;
+
+	const unsigned char	*as_dict;
+	int		as_dict_len;
+
+	int		as_method;
+	LZ_MODEL	as_lz_model;
+	unsigned char	as_lz_text[DICT_MAX_BYTES + LZ_MAX_BYTES];
+	int		as_lz_len;
+	unsigned char	as_lz_decode_text[DICT_MAX_BYTES + LZ_MAX_BYTES];
+};
+
+
+/*
+ * Divide by 2^n, rounding down, as an arithmetic shift would.
+ * Shifting a negative value right is implementation-defined in C.
+ */
+
+static int64_t
+shift_down (
+	int64_t		x,
+	int		n
+) {
+	return (x >= 0 ? x >> n : ~(~x >> n));
+}
+
+
+/*
+ * Return the logistic function of a stretched value, 1/(1+e^-d),
+ * as a 12-bit probability, by interpolating a table.
+ */
+
+static int
+squash (
+	int		d
+) {
+	static const int	t[33] = {
+		1, 2, 3, 6, 10, 16, 27, 45, 73, 120, 194, 310, 488, 747,
+		1101, 1546, 2047, 2549, 2994, 3348, 3607, 3785, 3901, 3975,
+		4022, 4050, 4068, 4079, 4085, 4089, 4092, 4093, 4094
+	};
+	int		w;
+
+	if (d > 2047)
+	    return (4095);
+	if (d < -2047)
+	    return (1);
+
+	d += 2048;
+	w = d & 127;
+	d >>= 7;
+
+	return ((t[d] * (128 - w) + t[d + 1] * w + 64) >> 7);
+}
+
+
+/*
+ * Stretch a 16-bit probability.
+ */
+
+static int
+stretch (
+	const ARITH_TABLES	*at,
+	int			p
+) {
+	return (at->at_stretch[p >> (PROB_BITS - STRETCH_BITS)]);
+}
+
+
+/*
+ * Build the table of stretched probabilities, as the inverse of squash,
+ * and the stretched predictions of the Huffman tables.
+ * A code of length n implies a probability of 2^-n for its byte, so the
+ * probability of a 1 at each node of the tree is the share of that
+ * probability below its 1 branch.
+ */
+
+static void
+arith_tables_build (
+	ARITH_TABLES	*at
+) {
+	int		x, i, t, pi = 0;
+
+	for (x = -2047; x <= 2047; x++) {
+	    int		v = squash (x);
+
+	    for (i = pi; i <= v; i++)
+		at->at_stretch[i] = x;
+	    pi = v + 1;
+	}
+
+	for (i = pi; i < (1 << STRETCH_BITS); i++)
+	    at->at_stretch[i] = 2047;
+
+	for (t=0; t<HUFF_TABLES; t++) {
+	    uint64_t	w[512];
+
+	    for (i=0; i<256; i++)
+		w[256 + i] = (uint64_t) 1 << (HUFF_MAX_LENGTH
+						- huff_codes[t][i].hc_length);
+	    for (i=255; i>=1; i--)
+		w[i] = w[2 * i] + w[2 * i + 1];
+
+	    for (i=1; i<256; i++) {
+		int	p = (w[2 * i + 1] << PROB_BITS) / w[i];
+
+		if (p < PROB_MIN)
+		    p = PROB_MIN;
+		else if (p > PROB_MAX)
+		    p = PROB_MAX;
+
+		at->at_prior[t][i] = stretch (at, p);
+	    }
+	}
+}
+
+
+/*
+ * Build the shared tables.
+ */
+
+static void
+arith_tables_init (void)
+{
+	arith_tables_build (&arith_tables);
+}
+
+
+/*
+ * Return the shared tables, building them if no context has yet.
+ */
+
+static const ARITH_TABLES *
+arith_tables_get (void)
+{
+#ifdef ARITH_ONCE
+	pthread_once (&arith_tables_once, arith_tables_init);
+#else
+	if (!arith_tables_built) {
+	    arith_tables_init ();
+	    arith_tables_built = TRUE;
+	}
+#endif
+
+	return (&arith_tables);
+}
+
+
+/*
+ * Initialize a probability to even odds.
+ */
+
+static void
+prob_init (
+	PROB		*pr
+) {
+	pr->pr_p1 = PROB_HALF;
+	pr->pr_n = 0;
+}
+
+
+/*
+ * Update a probability with the value of a coded bit.
+ */
+
+static void
+prob_update (
+	PROB		*pr,
+	int		bit
+) {
+	int		p = pr->pr_p1;
+	int		target = bit ? (1 << PROB_BITS) : 0;
+
+	p += (target - p) / (pr->pr_n + 2);
+	if (p < PROB_MIN)
+	    p = PROB_MIN;
+	else if (p > PROB_MAX)
+	    p = PROB_MAX;
+
+	pr->pr_p1 = p;
+	if (pr->pr_n < PROB_LIMIT)
+	    pr->pr_n++;
+}
+
+
+/*
+ * Initialize a model.
+ * The mixer starts by trusting all its inputs equally.
+ */
+
+static void
+model_init (
+	ARITH_MODEL		*am,
+	const ARITH_TABLES	*at,
+	int			method
+) {
+	int			i, j;
+
+	am->am_tables = at;
+	am->am_mixed = (method == METHOD_CM || method == METHOD_DICT);
+	am->am_prev = 0;
+
+	prob_init (&am->am_more);
+	for (i=0; i<256; i++)
+	    prob_init (&am->am_tree[i]);
+
+	if (!am->am_mixed)
+	    return;
+
+	for (i=0; i<256; i++)
+	    for (j=0; j<256; j++)
+		prob_init (&am->am_order1[i][j]);
+
+	for (i=0; i<MIX_INPUTS; i++)
+	    am->am_weights[i] = (i == 2) ? 0 : MIX_ONE / 4;
+}
+
+
+/*
+ * Predict the next bit of a byte, given the bits of it so far as a
+ * node of the tree.
+ * Returns the probability of a 1.
+ */
+
+static int
+model_predict (
+	ARITH_MODEL	*am,
+	int		ctx
+) {
+	int		i;
+	int64_t		dot = 0;
+
+	if (!am->am_mixed)
+	    return (am->am_tree[ctx].pr_p1);
+
+	am->am_inputs[0] = stretch (am->am_tables, am->am_tree[ctx].pr_p1);
+	am->am_inputs[1] = stretch (am->am_tables,
+				am->am_order1[am->am_prev][ctx].pr_p1);
+	am->am_inputs[2] = 256;
+	for (i=0; i<HUFF_TABLES; i++)
+	    am->am_inputs[3 + i] = am->am_tables->at_prior[i][ctx];
+
+	for (i=0; i<MIX_INPUTS; i++)
+	    dot += shift_down ((int64_t) am->am_inputs[i]
+						* am->am_weights[i], 8);
+
+	am->am_p = squash ((int) shift_down (dot, 8));
+
+	return ((am->am_p << (PROB_BITS - 12)) + (1 << (PROB_BITS - 13)));
+}
+
+
+/*
+ * Update the model with the value of a bit just coded.
+ * Each mixer weight moves in proportion to its input and the error
+ * of the mixed prediction.
+ */
+
+static void
+model_update (
+	ARITH_MODEL	*am,
+	int		ctx,
+	int		bit
+) {
+	int		i, err, w;
+
+	prob_update (&am->am_tree[ctx], bit);
+
+	if (!am->am_mixed)
+	    return;
+
+	prob_update (&am->am_order1[am->am_prev][ctx], bit);
+
+	err = (bit << 12) - am->am_p;
+	for (i=0; i<MIX_INPUTS; i++) {
+	    w = am->am_weights[i] + (int) shift_down ((int64_t) am->am_inputs[i]
+							* err, MIX_RATE);
+	    if (w > MIX_LIMIT)
+		w = MIX_LIMIT;
+	    else if (w < -MIX_LIMIT)
+		w = -MIX_LIMIT;
+	    am->am_weights[i] = w;
+	}
+}
+
+
+/*
+ * Find the split point of the coder's interval for a probability.
+ * Values up to and including it code a 1.
+ */
+
+static uint32_t
+coder_split (
+	const ARITH_CODER	*ac,
+	int			p1
+) {
+	return (ac->ac_x1 + (uint32_t) (((uint64_t) (ac->ac_x2 - ac->ac_x1)
+						* p1) >> PROB_BITS));
+}
+
+
+/*
+ * Encode a bit with the given probability of a 1.
+ */
+
+static BOOL
+coder_encode (
+	ARITH_CODER	*ac,
+	int		p1,
+	int		bit
+) {
+	uint32_t	xmid = coder_split (ac, p1);
+
+	if (bit)
+	    ac->ac_x2 = xmid;
+	else
+	    ac->ac_x1 = xmid + 1;
+
+	while (((ac->ac_x1 ^ ac->ac_x2) & 0x80000000UL) == 0) {
+	    ac->ac_out_word = (ac->ac_out_word << 1) | (ac->ac_x2 >> 31);
+	    ac->ac_out_bits++;
+
+	    if (++ac->ac_out_pending == 64) {
+		if (ac->ac_output != NULL && !ac->ac_output (ac->ac_ctx,
+			ac->ac_out_word, 64, ac->ac_inf, ac->ac_outf))
+		    return (FALSE);
+		ac->ac_out_pending = 0;
+	    }
+
+	    ac->ac_x1 <<= 1;
+	    ac->ac_x2 = (ac->ac_x2 << 1) | 1;
+	}
+
+	return (TRUE);
+}
+
+
+/*
+ * Read the next input bit into the decoder, padding with zeroes.
+ */
+
+static void
+coder_shift_in (
+	ARITH_CODER	*ac
+) {
+	int		bit = 0;
+
+	if (ac->ac_in_pos < ac->ac_in_bits)
+	    bit = SPAN_BIT (ac->ac_in, ac->ac_in_pos);
+	ac->ac_in_pos++;
+
+	ac->ac_x = (ac->ac_x << 1) | bit;
+}
+
+
+/*
+ * Decode a bit with the given probability of a 1.
+ */
+
+static int
+coder_decode (
+	ARITH_CODER	*ac,
+	int		p1
+) {
+	uint32_t	xmid = coder_split (ac, p1);
+	int		bit = (ac->ac_x <= xmid);
+
+	if (bit)
+	    ac->ac_x2 = xmid;
+	else
+	    ac->ac_x1 = xmid + 1;
+
+	while (((ac->ac_x1 ^ ac->ac_x2) & 0x80000000UL) == 0) {
+	    ac->ac_x1 <<= 1;
+	    ac->ac_x2 = (ac->ac_x2 << 1) | 1;
+	    coder_shift_in (ac);
+	}
+
+	return (bit);
+}
+
+
+/*
+ * Encode a bit with an adaptive probability, and update it.
+ */
+
+static BOOL
+prob_encode (
+	ARITH_CODER	*ac,
+	PROB		*pr,
+	int		bit
+) {
+	if (!coder_encode (ac, pr->pr_p1, bit))
+	    return (FALSE);
+
+	prob_update (pr, bit);
+
+	return (TRUE);
+}
+
+
+/*
+ * Decode a bit with an adaptive probability, and update it.
+ */
+
+static int
+prob_decode (
+	ARITH_CODER	*ac,
+	PROB		*pr
+) {
+	int		bit = coder_decode (ac, pr->pr_p1);
+
+	prob_update (pr, bit);
+
+	return (bit);
+}
+
+
+/*
+ * Encode a byte with a model.
+ */
+
+static BOOL
+model_encode_byte (
+	ARITH_CODER	*ac,
+	ARITH_MODEL	*am,
+	int		c
+) {
+	int		i, ctx = 1;
+
+	for (i=7; i>=0; i--) {
+	    int		bit = (c >> i) & 1;
+
+	    if (!coder_encode (ac, model_predict (am, ctx), bit))
+		return (FALSE);
+	    model_update (am, ctx, bit);
+	    ctx = (ctx << 1) | bit;
+	}
+
+	am->am_prev = c;
+
+	return (TRUE);
+}
+
+
+/*
+ * Decode a byte with a model.
+ */
+
+static int
+model_decode_byte (
+	ARITH_CODER	*ac,
+	ARITH_MODEL	*am
+) {
+	int		i, ctx = 1;
+
+	for (i=0; i<8; i++) {
+	    int		bit = coder_decode (ac, model_predict (am, ctx));
+
+	    model_update (am, ctx, bit);
+	    ctx = (ctx << 1) | bit;
+	}
+
+	return (am->am_prev = ctx & 0xff);
+}
+
+
+/*
+ * Update a model with a byte that isn't coded, such as one copied
+ * by a match.
+ */
+
+static void
+model_train_byte (
+	ARITH_MODEL	*am,
+	int		c
+) {
+	int		i, ctx = 1;
+
+	for (i=7; i>=0; i--) {
+	    int		bit = (c >> i) & 1;
+
+	    model_predict (am, ctx);
+	    model_update (am, ctx, bit);
+	    ctx = (ctx << 1) | bit;
+	}
+
+	am->am_prev = c;
+}
+
+
+/*
+ * Initialize a model of numbers.
+ */
+
+static void
+gamma_init (
+	GAMMA_MODEL	*gm
+) {
+	int		i, j;
+
+	for (i=0; i<LZ_GAMMA_BITS; i++) {
+	    prob_init (&gm->gm_size[i]);
+	    for (j=0; j<LZ_GAMMA_BITS; j++)
+		prob_init (&gm->gm_bits[i][j]);
+	}
+}
+
+
+/*
+ * Encode a number, from 1 to 2^LZ_GAMMA_BITS - 1.
+ */
+
+static BOOL
+gamma_encode (
+	ARITH_CODER	*ac,
+	GAMMA_MODEL	*gm,
+	int		v
+) {
+	int		i, nb = 0;
+
+	while ((v >> nb) > 1)
+	    nb++;
+
+	for (i=0; i<nb; i++)
+	    if (!prob_encode (ac, &gm->gm_size[i], 1))
+		return (FALSE);
+	if (nb < LZ_GAMMA_BITS - 1 && !prob_encode (ac, &gm->gm_size[nb], 0))
+	    return (FALSE);
+
+	for (i = nb - 1; i >= 0; i--)
+	    if (!prob_encode (ac, &gm->gm_bits[nb][i], (v >> i) & 1))
+		return (FALSE);
+
+	return (TRUE);
+}
+
+
+/*
+ * Decode a number.
+ */
+
+static int
+gamma_decode (
+	ARITH_CODER	*ac,
+	GAMMA_MODEL	*gm
+) {
+	int		i, nb = 0, v = 1;
+
+	while (nb < LZ_GAMMA_BITS - 1 && prob_decode (ac, &gm->gm_size[nb]))
+	    nb++;
+
+	for (i = nb - 1; i >= 0; i--)
+	    v = (v << 1) | prob_decode (ac, &gm->gm_bits[nb][i]);
+
+	return (v);
+}
+
+
+/*
+ * Initialize the models of the dictionary method, and train the
+ * literal model on the dictionary.
+ */
+
+static void
+lz_init (
+	LZ_MODEL		*lm,
+	ARITH_MODEL		*am,
+	const unsigned char	*dict,
+	int			dict_len
+) {
+	int			i;
+
+	prob_init (&lm->lm_match[0]);
+	prob_init (&lm->lm_match[1]);
+	lm->lm_last_match = 0;
+	gamma_init (&lm->lm_length);
+	gamma_init (&lm->lm_distance);
+
+	for (i=0; i<dict_len; i++)
+	    model_train_byte (am, dict[i]);
+}
+
+
+/*
+ * Find the longest match for the text at a position, searching back
+ * from the nearest position so that ties favour short distances.
+ * Returns the match length, or 0 if it is too short to use.
+ */
+
+static int
+lz_match_find (
+	const unsigned char	*text,
+	int			pos,
+	int			end,
+	int			*distance
+) {
+	int			i, best = 0, max = end - pos;
+
+	if (max > LZ_MAX_MATCH)
+	    max = LZ_MAX_MATCH;
+	if (max < LZ_MIN_MATCH)
+	    return (0);
+
+	for (i = pos - 1; i >= 0; i--) {
+	    int		len = 0;
+
+	    if (text[i] != text[pos] || text[i + best] != text[pos + best])
+		continue;
+
+	    while (len < max && text[i + len] == text[pos + len])
+		len++;
+
+	    if (len > best) {
+		best = len;
+		*distance = pos - i;
+		if (best == max)
+		    break;
+	    }
+	}
+
+	return ((best >= LZ_MIN_MATCH) ? best : 0);
+}
+
+
+/*
+ * Encode the text from start to end as literals and matches, each
+ * preceded by a flag saying that the message continues.
+ */
+
+static BOOL
+lz_encode (
+	ARITH_CODER		*ac,
+	ARITH_MODEL		*am,
+	LZ_MODEL		*lm,
+	const unsigned char	*text,
+	int			start,
+	int			end
+) {
+	int			i, pos = start;
+
+	while (pos < end) {
+	    int		distance = 0;
+	    int		len = lz_match_find (text, pos, end, &distance);
+	    PROB	*match = &lm->lm_match[lm->lm_last_match];
+
+	    if (!prob_encode (ac, &am->am_more, 1)
+				|| !prob_encode (ac, match, len != 0))
+		return (FALSE);
+	    lm->lm_last_match = (len != 0);
+
+	    if (len == 0) {
+		if (!model_encode_byte (ac, am, text[pos]))
+		    return (FALSE);
+		pos++;
+		continue;
+	    }
+
+	    if (!gamma_encode (ac, &lm->lm_length, len - LZ_MIN_MATCH + 1)
+		    || !gamma_encode (ac, &lm->lm_distance, distance))
+		return (FALSE);
+
+	    for (i=0; i<len; i++)
+		model_train_byte (am, text[pos++]);
+	}
+
+	return (TRUE);
+}
+
+
+/*
+ * Decode literals and matches into the text after the dictionary,
+ * until the end of the message.
+ * Returns the end of the text, or -1 if the data is corrupt or would
+ * overflow the text.
+ */
+
+static int
+lz_decode (
+	ARITH_CODER	*ac,
+	ARITH_MODEL	*am,
+	LZ_MODEL	*lm,
+	unsigned char	*text,
+	int		start,
+	int		maxend
+) {
+	int		i, pos = start;
+
+	while (prob_decode (ac, &am->am_more)) {
+	    int		len, distance;
+
+		/* A valid message never needs more padding than this */
+	    if (ac->ac_in_pos > ac->ac_in_bits + 64)
+		return (-1);
+
+	    lm->lm_last_match = prob_decode (ac,
+					&lm->lm_match[lm->lm_last_match]);
+
+	    if (!lm->lm_last_match) {
+		if (pos == maxend)
+		    return (-1);
+		text[pos++] = model_decode_byte (ac, am);
+		continue;
+	    }
+
+	    len = gamma_decode (ac, &lm->lm_length) + LZ_MIN_MATCH - 1;
+	    distance = gamma_decode (ac, &lm->lm_distance);
+
+	    if (len > maxend - pos || distance > pos)
+		return (-1);
+
+	    for (i=0; i<len; i++, pos++) {
+		text[pos] = text[pos - distance];
+		model_train_byte (am, text[pos]);
+	    }
+	}
+
+	return (pos);
+}
+
+
+/*
+ * Create the arithmetic coding state of a context.
+ * Returns NULL if memory runs out.
+ */
+
+ARITH_STATE *
+arith_state_create (void)
+{
+	ARITH_STATE	*as;
+
+	if ((as = (ARITH_STATE *) malloc (sizeof (ARITH_STATE))) == NULL)
+	    return (NULL);
+
+	as->as_dict = NULL;
+	as->as_dict_len = 0;
+	as->as_coder.ac_out_bits = 0;
+
+	return (as);
+}
+
+
+/*
+ * Destroy the arithmetic coding state of a context.
+ */
+
+void
+arith_state_destroy (
+	ARITH_STATE	*as
+) {
+	free (as);
+}
+
+
+/*
+ * Set the preset dictionary used by the dictionary method.
+ * The dictionary isn't copied, so must remain in place while it is used.
+ */
+
+void
+arith_dictionary_set (
+	CONTEXT			*ctx,
+	const unsigned char	*dict,
+	int			len
+) {
+	ARITH_STATE		*as = ctx->ctx_arith;
+
+	as->as_dict = dict;
+	as->as_dict_len = (len > DICT_MAX_BYTES) ? DICT_MAX_BYTES : len;
+}
+
+
+/*
+ * Initialize the arithmetic encoder with one of the arithmetic coding
+ * methods. Settled bits are passed to the output function, or just
+ * counted if it is NULL.
+ */
+
+void
+arith_encode_init (
+	CONTEXT		*ctx,
+	int		method,
+	ARITH_OUTPUT	output
+) {
+	ARITH_STATE	*as = ctx->ctx_arith;
+	ARITH_CODER	*ac = &as->as_coder;
+
+	model_init (&as->as_model, arith_tables_get (), method);
+	as->as_method = method;
+
+	ac->ac_x1 = 0;
+	ac->ac_x2 = 0xffffffffUL;
+	ac->ac_out_bits = 0;
+	ac->ac_out_word = 0;
+	ac->ac_out_pending = 0;
+	ac->ac_output = output;
+	ac->ac_ctx = ctx;
+
+	if (method == METHOD_DICT) {
+	    lz_init (&as->as_lz_model, &as->as_model, as->as_dict,
+							as->as_dict_len);
+	    if (as->as_dict_len > 0)
+		memcpy (as->as_lz_text, as->as_dict, as->as_dict_len);
+	    as->as_lz_len = as->as_dict_len;
+	}
+}
+
+
+/*
+ * Encode a byte, passing the settled bits on to the output function.
+ * The dictionary method only holds on to it, to be encoded when the
+ * encoder is flushed.
+ */
+
+BOOL
+arith_encode_byte (
+	CONTEXT		*ctx,
+	int		c,
+	FILE		*inf,
+	FILE		*outf
+) {
+	ARITH_STATE	*as = ctx->ctx_arith;
+	ARITH_CODER	*ac = &as->as_coder;
+
+	if (as->as_method == METHOD_DICT) {
+	    if (as->as_lz_len == as->as_dict_len + LZ_MAX_BYTES) {
+		fprintf (stderr, "Message is too long for a dictionary.\n");
+		return (FALSE);
+	    }
+
+	    as->as_lz_text[as->as_lz_len++] = c;
+	    return (TRUE);
+	}
+
+	ac->ac_inf = inf;
+	ac->ac_outf = outf;
+
+	return (prob_encode (ac, &as->as_model.am_more, 1)
+				&& model_encode_byte (ac, &as->as_model, c));
+}
+
+
+/*
+ * Mark the end of the message, and flush the encoder.
+ * x1 and x2 differ in their top bit, so a single 1 bit, followed by
+ * the zeroes the decoder pads with, lies within the interval.
+ */
+
+BOOL
+arith_encode_flush (
+	CONTEXT		*ctx,
+	FILE		*inf,
+	FILE		*outf
+) {
+	ARITH_STATE	*as = ctx->ctx_arith;
+	ARITH_CODER	*ac = &as->as_coder;
+
+	ac->ac_inf = inf;
+	ac->ac_outf = outf;
+
+	if (as->as_method == METHOD_DICT && !lz_encode (ac, &as->as_model,
+				&as->as_lz_model, as->as_lz_text,
+				as->as_dict_len, as->as_lz_len))
+	    return (FALSE);
+
+	if (!coder_encode (ac, as->as_model.am_more.pr_p1, 0))
+	    return (FALSE);
+
+	ac->ac_out_word = (ac->ac_out_word << 1) | 1;
+	ac->ac_out_pending++;
+	ac->ac_out_bits++;
+
+	return (ac->ac_output == NULL || ac->ac_output (ctx, ac->ac_out_word,
+					ac->ac_out_pending, inf, outf));
+}
+
+
+/*
+ * Return the number of bits output by the encoder.
+ */
+
+int
+arith_encoded_bits (
+	CONTEXT		*ctx
+) {
+	return (ctx->ctx_arith->as_coder.ac_out_bits);
+}
+
+
+/*
+ * Return the number of bits a buffer would be encoded in, or -1 if
+ * it is too long for the method.
+ * This uses, and resets, the encoder.
+ */
+
+int
+arith_encoded_size (
+	CONTEXT			*ctx,
+	int			method,
+	const unsigned char	*buf,
+	int			n
+) {
+	int			i;
+
+	if (method == METHOD_DICT && n > LZ_MAX_BYTES)
+	    return (-1);
+
+	arith_encode_init (ctx, method, NULL);
+	for (i=0; i<n; i++)
+	    arith_encode_byte (ctx, buf[i], NULL, NULL);
+	arith_encode_flush (ctx, NULL, NULL);
+
+	return (arith_encoded_bits (ctx));
+}
+
+
+/*
+ * Decode a message from a span of bits.
+ * Returns the number of bytes decoded into buf, or -1 if the data
+ * is corrupt or would overflow the buffer.
+ */
+
+int
+arith_decode (
+	CONTEXT		*ctx,
+	int		method,
+	const uint64_t	*words,
+	int		nbits,
+	unsigned char	*buf,
+	int		maxlen
+) {
+	ARITH_STATE	*as = ctx->ctx_arith;
+	ARITH_MODEL	*am = &as->as_decode_model;
+	ARITH_CODER	ac;
+	int		i, n = 0;
+
+	model_init (am, arith_tables_get (), method);
+
+	ac.ac_x1 = 0;
+	ac.ac_x2 = 0xffffffffUL;
+	ac.ac_x = 0;
+	ac.ac_in = words;
+	ac.ac_in_bits = nbits;
+	ac.ac_in_pos = 0;
+
+	for (i=0; i<32; i++)
+	    coder_shift_in (&ac);
+
+	if (method == METHOD_DICT) {
+	    unsigned char	*text = as->as_lz_decode_text;
+	    int			dict_len = as->as_dict_len;
+	    LZ_MODEL		lm;
+	    int			end;
+
+	    if (maxlen > LZ_MAX_BYTES)
+		maxlen = LZ_MAX_BYTES;
+
+	    lz_init (&lm, am, as->as_dict, dict_len);
+	    if (dict_len > 0)
+		memcpy (text, as->as_dict, dict_len);
+
+	    if ((end = lz_decode (&ac, am, &lm, text, dict_len,
+						dict_len + maxlen)) < 0)
+		return (-1);
+
+	    n = end - dict_len;
+	    memcpy (buf, &text[dict_len], n);
+
+	    return (n);
+	}
+
+	while (prob_decode (&ac, &am->am_more)) {
+		/* A valid message never needs more padding than this */
+	    if (n == maxlen || ac.ac_in_pos > nbits + 64)
+		return (-1);
+
+	    buf[n++] = model_decode_byte (&ac, am);
+	}
+
+	return (n);
+}
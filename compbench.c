@@ -0,0 +1,153 @@
+/*
+ * Benchmark the compression methods of the gifshuffle steganography
+ * program on short payloads.
+ * Each file named on the command line is a class of payload, such as
+ * IDs or URLs, holding one payload per line. The average number of bits
+ * each method compresses a payload of the class into is reported, along
+ * with the uncompressed size. Each Huffman table is reported separately,
+ * and the dictionary method with whichever built-in dictionary suits
+ * the payload best, counting the bits that record the dictionary.
+ */
+
+#include "gifshuf.h"
+
+#include <string.h>
+
+
+/*
+ * The longest payload measured.
+ */
+
+#define BENCH_MAX_LENGTH	1024
+
+
+/*
+ * Return the number of bits a payload is compressed into by a
+ * Huffman table.
+ */
+
+static int
+huffman_size (
+	int			table,
+	const unsigned char	*buf,
+	int			n
+) {
+	int			i, bits = 0;
+
+	for (i=0; i<n; i++)
+	    bits += huff_codes[table][buf[i]].hc_length;
+
+	return (bits);
+}
+
+
+/*
+ * Measure one class of payload, and print a line of results.
+ */
+
+static BOOL
+bench_class (
+	CONTEXT		*ctx,
+	const char	*path
+) {
+	FILE		*fp;
+	char		line[BENCH_MAX_LENGTH + 2];
+	const char	*name;
+	int		name_len;
+	long		raw = 0, huff[HUFF_TABLES], range = 0, cm = 0, dict = 0;
+	int		t, npayloads = 0;
+
+	if ((fp = fopen (path, "r")) == NULL) {
+	    perror (path);
+	    return (FALSE);
+	}
+
+	for (t=0; t<HUFF_TABLES; t++)
+	    huff[t] = 0;
+
+	while (fgets (line, sizeof (line), fp) != NULL) {
+	    const unsigned char	*buf = (const unsigned char *) line;
+	    int			d, n = strlen (line), min = -1;
+
+	    if (n > 0 && line[n - 1] == '\n')
+		line[--n] = '\0';
+	    if (n == 0)
+		continue;
+
+	    raw += n * 8;
+	    for (t=0; t<HUFF_TABLES; t++)
+		huff[t] += huffman_size (t, buf, n);
+	    range += arith_encoded_size (ctx, METHOD_RANGE, buf, n);
+	    cm += arith_encoded_size (ctx, METHOD_CM, buf, n);
+
+	    for (d=0; d<DICT_BUILTINS; d++) {
+		int	bits;
+
+		dict_select (ctx, d);
+		bits = arith_encoded_size (ctx, METHOD_DICT, buf, n);
+		if (min < 0 || bits < min)
+		    min = bits;
+	    }
+	    dict += min + DICT_ID_BITS;
+	    npayloads++;
+	}
+
+	fclose (fp);
+
+	if ((name = strrchr (path, '/')) != NULL)
+	    name++;
+	else
+	    name = path;
+	name_len = strcspn (name, ".");	/* Without the extension */
+
+	if (npayloads == 0) {
+	    printf ("%-12.*s no payloads\n", name_len, name);
+	    return (TRUE);
+	}
+
+	printf ("%-12.*s %5d %7.1f", name_len, name, npayloads,
+						(double) raw / npayloads);
+	for (t=0; t<HUFF_TABLES; t++)
+	    printf (" %7.1f", (double) huff[t] / npayloads);
+	printf (" %7.1f %7.1f %7.1f\n", (double) range / npayloads,
+			(double) cm / npayloads, (double) dict / npayloads);
+
+	return (TRUE);
+}
+
+
+/*
+ * Program's starting point.
+ * Measures each class of payload in turn.
+ */
+
+int
+main (
+	int		argc,
+	char		*argv[]
+) {
+	int		i, t, status = 0;
+	CONTEXT		*ctx;
+
+	if (argc < 2) {
+	    fprintf (stderr, "Usage: %s payloads.txt ...\n", argv[0]);
+	    return (1);
+	}
+
+	if ((ctx = context_create ()) == NULL)
+	    return (1);
+
+	printf ("Average bits per payload\n");
+	printf ("%-12s %5s %7s", "class", "count", "raw");
+	for (t=0; t<HUFF_TABLES; t++)
+	    printf (" %7s", huff_table_names[t]);
+	printf (" %7s %7s %7s\n", "range", "cm", "dict");
+
+	for (i=1; i<argc; i++)
+	    if (!bench_class (ctx, argv[i]))
+		status = 1;
+
+	context_destroy (ctx);
+
+	return (status);
+}
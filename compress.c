@@ -1,32 +1,491 @@
 /*
  * Compression routines for the gifshuffle steganography program.
- * Uses simple Huffman coding.
+ * Uses simple Huffman coding, or optionally arithmetic coding with an
+ * order-0 or context-mixing model, or with matches against a preset
+ * dictionary, or whichever of these, or no compression at all, gives
+ * the smallest result.
  *
  * Written by Matthew Kwan - December 1996
  */
 
 #include "gifshuf.h"
+#include "epi.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+#if defined (unix) || defined (__unix__)
+#include <pthread.h>
+#define HUFF_ONCE
+#endif
+
+
+/*
+ * Find a Huffman code table by name or ID.
+ * Returns the table's ID, or -1 if there is no such table.
+ */
+
+int
+huff_table_find (
+	const char	*name
+) {
+	int		i;
+
+	for (i=0; i<HUFF_TABLES; i++)
+	    if (strcmp (name, huff_table_names[i]) == 0)
+		return (i);
+
+	if (name[0] >= '0' && name[0] < '0' + HUFF_TABLES && name[1] == '\0')
+	    return (name[0] - '0');
+
+	return (-1);
+}
+
+
+/*
+ * Return the name of a Huffman code table.
+ */
+
+const char *
+huff_table_name (
+	int		table
+) {
+	return (huff_table_names[table]);
+}
+
+
+/*
+ * The names of the compression methods, other than Huffman tables.
+ */
+
+static const struct {
+	const char	*cm_name;
+	int		cm_method;
+} compress_methods[] = {
+	{"huffman",	METHOD_HUFFMAN},
+	{"range",	METHOD_RANGE},
+	{"cm",		METHOD_CM},
+	{"dict",	METHOD_DICT},
+	{"auto",	METHOD_AUTO},
+	{NULL,		0}
+};
+
+
+/*
+ * Find a compression method by name.
+ * Returns the method, or -1 if there is no such method.
+ */
+
+int
+compress_method_find (
+	const char	*name
+) {
+	int		i;
+
+	for (i=0; compress_methods[i].cm_name != NULL; i++)
+	    if (strcmp (name, compress_methods[i].cm_name) == 0)
+		return (compress_methods[i].cm_method);
+
+	return (-1);
+}
+
+
+/*
+ * Return the name of a method ID, as recorded in a payload header.
+ */
+
+const char *
+compress_method_name (
+	int		id
+) {
+	int		i;
+
+	if (id == METHOD_NONE)
+	    return ("none");
+	if (id >= METHOD_HUFFMAN && id < METHOD_HUFFMAN + HUFF_TABLES)
+	    return (huff_table_names[id - METHOD_HUFFMAN]);
+
+	for (i=0; compress_methods[i].cm_name != NULL; i++)
+	    if (compress_methods[i].cm_method == id)
+		return (compress_methods[i].cm_name);
+
+	return ("unknown");
+}
+
+
+/*
+ * The stage that bytes are compressed by, chosen when the method is.
+ */
+
+typedef BOOL	(*COMPRESS_STAGE) (CONTEXT *ctx, const unsigned char *buf,
+					int n, FILE *inf, FILE *outf);
+
+
+/*
+ * Compressed bits are passed on to be encrypted in spans of at most
+ * this many words.
+ */
+
+#define COMPRESS_SPAN_WORDS	32
+
+
+/*
+ * The longest message held when the method is chosen automatically,
+ * and the most bytes a message can be uncompressed into.
+ */
+
+#define COMPRESS_MAX_BYTES	65536
+#define UNCOMPRESS_MAX_BYTES	65536
+
 
 /*
- * The Huffman codes.
+ * The Huffman decoding table. The root table is indexed by the next
+ * HUFF_ROOT_BITS bits of input. Codes longer than that have an entry
+ * linking to a subtable, indexed by the bits that follow, which is
+ * just big enough for the longest code with that prefix. All the
+ * tables are held in one array. The tables for every code table are
+ * built the first time any context needs one, and shared by them all
+ * until the process ends.
  */
 
-static const char	*huffcodes[256] = {
-#include "huffcode.h"
+#define HUFF_ROOT_BITS		10
+
+typedef struct {
+	short		he_symbol;	/* -1 for a subtable link */
+	unsigned char	he_length;	/* Code or subtable bits, 0 if unused */
+	int		he_sub;		/* Offset of the subtable */
+} HUFF_ENTRY;
+
+static HUFF_ENTRY	*huff_decode_tables[HUFF_TABLES];
+static int		huff_max_lengths[HUFF_TABLES];
+
+#ifdef HUFF_ONCE
+static pthread_once_t	huff_decode_once = PTHREAD_ONCE_INIT;
+#else
+static BOOL		huff_decode_built = FALSE;
+#endif
+
+
+/*
+ * The compression state of a context.
+ * The method used for the current message starts as the one in the
+ * context's options, which are left alone, and may be replaced by the
+ * one chosen automatically.
+ * With automatic selection the message is held until all of it has
+ * been seen. When uncompressing, the message bits are collected, and
+ * uncompressed all at once when flushed, into a buffer of bytes.
+ */
+
+struct compress_state_struct {
+	BOOL		cs_flag;
+	int		cs_method;
+	int		cs_table;
+	int		cs_dict;
+	BOOL		cs_tag_pending;	/* Method tag still to be written */
+
+	int		cs_bit_count;
+	int		cs_value;
+	int		cs_bits_in;
+	int		cs_bits_out;
+	COMPRESS_STAGE	cs_stage;
+
+	unsigned char	cs_buf[COMPRESS_MAX_BYTES];
+	int		cs_buf_len;
+
+	uint64_t	cs_uncompress_words[SPAN_WORDS (EPI_MAX_BITS)];
+	int		cs_uncompress_nbits;
+	unsigned char	cs_uncompress_buf[UNCOMPRESS_MAX_BYTES];
 };
 
 
 /*
- * Local variables used for compression.
+ * Create the compression state of a context.
+ * Returns NULL if memory runs out.
  */
 
-static int	compress_bit_count;
-static int	compress_value;
-static int	compress_bits_in;
-static int	compress_bits_out;
+COMPRESS_STATE *
+compress_state_create (void)
+{
+	return ((COMPRESS_STATE *) calloc (1, sizeof (COMPRESS_STATE)));
+}
+
+
+/*
+ * Destroy the compression state of a context.
+ */
+
+void
+compress_state_destroy (
+	COMPRESS_STATE	*cs
+) {
+	free (cs);
+}
+
+
+/*
+ * Return the method ID of the current message, to record in a payload
+ * header. Huffman coding records the ID of its table.
+ */
+
+int
+compress_method_id (
+	const CONTEXT	*ctx
+) {
+	const COMPRESS_STATE	*cs = ctx->ctx_compress;
+
+	if (!cs->cs_flag)
+	    return (METHOD_NONE);
+	if (cs->cs_method == METHOD_HUFFMAN)
+	    return (METHOD_HUFFMAN + cs->cs_table);
+
+	return (cs->cs_method);
+}
+
+
+/*
+ * Set the method of the current message from a method ID, as chosen
+ * automatically or read from a payload header or method tag.
+ * The context's options are left alone.
+ * Returns FALSE if the method is unknown.
+ */
+
+BOOL
+compress_method_set (
+	CONTEXT		*ctx,
+	int		id
+) {
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+
+	if (id == METHOD_NONE) {
+	    cs->cs_flag = FALSE;
+	    return (TRUE);
+	}
+
+	if (id >= METHOD_HUFFMAN && id < METHOD_HUFFMAN + HUFF_TABLES) {
+	    cs->cs_method = METHOD_HUFFMAN;
+	    cs->cs_table = id - METHOD_HUFFMAN;
+	} else if (id == METHOD_RANGE || id == METHOD_CM || id == METHOD_DICT)
+	    cs->cs_method = id;
+	else
+	    return (FALSE);
+
+	cs->cs_flag = TRUE;
+
+	return (TRUE);
+}
+
+
+/*
+ * Start the current message with the method in the context's options.
+ */
+
+static void
+compress_method_reset (
+	CONTEXT		*ctx
+) {
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+
+	cs->cs_flag = ctx->ctx_compress_flag;
+	cs->cs_method = ctx->ctx_compress_method;
+	cs->cs_table = ctx->ctx_compress_table;
+	cs->cs_dict = ctx->ctx_compress_dict;
+}
+
+
+/*
+ * Is the current message preceded by a method tag? Every method but
+ * Huffman coding is, unless a payload header records the method.
+ */
+
+static BOOL
+compress_tagged (
+	const CONTEXT	*ctx
+) {
+	const COMPRESS_STATE	*cs = ctx->ctx_compress;
+
+	return (cs->cs_flag && cs->cs_method != METHOD_HUFFMAN
+						&& !ctx->ctx_header_flag);
+}
+
+
+/*
+ * Write the method tag, if it is still to be written, ahead of the
+ * first compressed bits.
+ */
+
+static BOOL
+compress_tag_write (
+	CONTEXT		*ctx,
+	FILE		*inf,
+	FILE		*outf
+) {
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+
+	if (!cs->cs_tag_pending)
+	    return (TRUE);
+
+	cs->cs_tag_pending = FALSE;
+
+	return (encrypt_word (ctx, compress_method_id (ctx),
+					HEADER_METHOD_BITS, inf, outf));
+}
+
+
+/*
+ * Pass bytes on to be encrypted without compressing them.
+ */
+
+static BOOL
+compress_none (
+	CONTEXT			*ctx,
+	const unsigned char	*buf,
+	int			n,
+	FILE			*inf,
+	FILE			*outf
+) {
+	uint64_t		out[COMPRESS_SPAN_WORDS];
+	int			i, m;
+
+	for (; n > 0; n -= m, buf += m) {
+	    uint64_t	acc = 0;
+
+	    m = (n < COMPRESS_SPAN_WORDS * 8) ? n : COMPRESS_SPAN_WORDS * 8;
+	    for (i=0; i<m; i++) {
+		acc = (acc << 8) | buf[i];
+		if ((i & 7) == 7)
+		    out[i >> 3] = acc;
+	    }
+	    if ((m & 7) != 0)
+		out[m >> 3] = acc << (64 - (m & 7) * 8);
+
+	    if (!encrypt_span (ctx, out, m * 8, inf, outf))
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+
+/*
+ * Hold on to bytes until the whole message has been seen.
+ */
+
+static BOOL
+compress_hold (
+	CONTEXT			*ctx,
+	const unsigned char	*buf,
+	int			n,
+	FILE			*inf,
+	FILE			*outf
+) {
+	COMPRESS_STATE		*cs = ctx->ctx_compress;
+
+	if (n > COMPRESS_MAX_BYTES - cs->cs_buf_len) {
+	    fprintf (stderr, "Message is too long to compress.\n");
+	    return (FALSE);
+	}
+
+	memcpy (&cs->cs_buf[cs->cs_buf_len], buf, n);
+	cs->cs_buf_len += n;
+
+	return (TRUE);
+}
+
+
+/*
+ * Compress bytes with the current Huffman table.
+ * Codes are packed into a span, which is passed on to be encrypted
+ * whenever it fills.
+ */
+
+static BOOL
+compress_huffman (
+	CONTEXT			*ctx,
+	const unsigned char	*buf,
+	int			n,
+	FILE			*inf,
+	FILE			*outf
+) {
+	COMPRESS_STATE		*cs = ctx->ctx_compress;
+	const HUFF_CODE		*codes;
+	uint64_t		out[COMPRESS_SPAN_WORDS];
+	int			i, nout = 0;
+
+	codes = huff_codes[cs->cs_table];
+
+	cs->cs_bits_in += n * 8;
+
+	for (i=0; i<n; i++) {
+	    const HUFF_CODE	*hc = &codes[buf[i]];
+
+	    if (nout + hc->hc_length > COMPRESS_SPAN_WORDS * 64) {
+		if (!encrypt_span (ctx, out, nout, inf, outf))
+		    return (FALSE);
+		nout = 0;
+	    }
+
+	    span_write (out, nout, hc->hc_code, hc->hc_length);
+	    nout += hc->hc_length;
+	    cs->cs_bits_out += hc->hc_length;
+	}
+
+	return (encrypt_span (ctx, out, nout, inf, outf));
+}
+
+
+/*
+ * Compress bytes with the arithmetic coder, which passes on its output
+ * to be encrypted a word at a time.
+ */
+
+static BOOL
+compress_arith (
+	CONTEXT			*ctx,
+	const unsigned char	*buf,
+	int			n,
+	FILE			*inf,
+	FILE			*outf
+) {
+	int			i;
+
+	if (!compress_tag_write (ctx, inf, outf))
+	    return (FALSE);
+
+	ctx->ctx_compress->cs_bits_in += n * 8;
+
+	for (i=0; i<n; i++)
+	    if (!arith_encode_byte (ctx, buf[i], inf, outf))
+		return (FALSE);
+
+	return (TRUE);
+}
+
+
+/*
+ * Choose the compression stage for the current method, initializing
+ * the arithmetic encoder if it is used.
+ */
+
+static void
+compress_stage_select (
+	CONTEXT		*ctx
+) {
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+
+	if (!cs->cs_flag)
+	    cs->cs_stage = compress_none;
+	else if (cs->cs_method == METHOD_AUTO)
+	    cs->cs_stage = compress_hold;
+	else if (cs->cs_method == METHOD_HUFFMAN)
+	    cs->cs_stage = compress_huffman;
+	else {
+	    if (cs->cs_method == METHOD_DICT)
+		dict_select (ctx, cs->cs_dict);
+
+	    arith_encode_init (ctx, cs->cs_method, encrypt_word);
+	    cs->cs_stage = compress_arith;
+	}
+}
 
 
 /*
@@ -34,14 +493,49 @@ static int	compress_bits_out;
  */
 
 void
-compress_init (void)
-{
-	compress_bit_count = 0;
-	compress_value = 0;
-	compress_bits_in = 0;
-	compress_bits_out = 0;
+compress_init (
+	CONTEXT		*ctx
+) {
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+
+	compress_method_reset (ctx);
+	cs->cs_tag_pending = compress_tagged (ctx);
+	cs->cs_bit_count = 0;
+	cs->cs_value = 0;
+	cs->cs_bits_in = 0;
+	cs->cs_bits_out = 0;
+	cs->cs_buf_len = 0;
 
-	encrypt_init ();
+	compress_stage_select (ctx);
+
+	encrypt_init (ctx);
+}
+
+
+/*
+ * Compress a span of bytes.
+ */
+
+BOOL
+compress_bytes (
+	CONTEXT			*ctx,
+	const unsigned char	*buf,
+	int			n,
+	FILE			*inf,
+	FILE			*outf
+) {
+	int			i;
+
+		/* Finish any partial byte from compress_bit() first */
+	if (ctx->ctx_compress->cs_bit_count != 0) {
+	    for (i=0; i<n * 8; i++)
+		if (!compress_bit (ctx, (buf[i >> 3] >> (7 - (i & 7))) & 1,
+								inf, outf))
+		    return (FALSE);
+	    return (TRUE);
+	}
+
+	return (ctx->ctx_compress->cs_stage (ctx, buf, n, inf, outf));
 }
 
 
@@ -51,41 +545,121 @@ compress_init (void)
 
 BOOL
 compress_bit (
+	CONTEXT		*ctx,
 	int		bit,
 	FILE		*inf,
 	FILE		*outf
 ) {
-	if (!compress_flag)
-	    return (encrypt_bit (bit, inf, outf));
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
 
-	compress_bits_in++;
-	compress_value = (compress_value << 1) | bit;
+	if (!cs->cs_flag)
+	    return (encrypt_bit (ctx, bit, inf, outf));
 
-	if (++compress_bit_count == 8) {
-	    const char	*s;
+	cs->cs_value = (cs->cs_value << 1) | bit;
 
-	    for (s = huffcodes[compress_value]; *s != '\0'; s++) {
-		int	bit;
+	if (++cs->cs_bit_count == 8) {
+	    unsigned char	c = cs->cs_value;
 
-		if (*s == '1')
-		    bit = 1;
-		else if (*s == '0')
-		    bit = 0;
-		else {
-		    fprintf (stderr, "Illegal Huffman character '%c'\n", *s);
-		    return (FALSE);
-		}
+	    cs->cs_value = 0;
+	    cs->cs_bit_count = 0;
 
-		if (!encrypt_bit (bit, inf, outf))
-		    return (FALSE);
-		compress_bits_out++;
+	    return (compress_bytes (ctx, &c, 1, inf, outf));
+	}
+
+	return (TRUE);
+}
+
+
+/*
+ * Choose the method that stores the buffered message in the fewest bits.
+ * On a tie the simpler method is preferred. The dictionary method is
+ * tried with each built-in dictionary, and any loaded from a file, and
+ * the best is returned in dict.
+ * Returns the method's ID.
+ */
+
+static int
+compress_auto_choose (
+	CONTEXT			*ctx,
+	int			*dict
+) {
+	const unsigned char	*buf = ctx->ctx_compress->cs_buf;
+	int			n = ctx->ctx_compress->cs_buf_len;
+	int			i, t, bits, best = METHOD_NONE;
+	int			best_bits = n * 8, best_dict = -1;
+
+	for (t=0; t<HUFF_TABLES; t++) {
+	    for (bits = 0, i=0; i<n; i++)
+		bits += huff_codes[t][buf[i]].hc_length;
+
+	    if (bits < best_bits) {
+		best_bits = bits;
+		best = METHOD_HUFFMAN + t;
 	    }
+	}
 
-	    compress_value = 0;
-	    compress_bit_count = 0;
+	if ((bits = arith_encoded_size (ctx, METHOD_RANGE, buf, n))
+								< best_bits) {
+	    best_bits = bits;
+	    best = METHOD_RANGE;
 	}
 
-	return (TRUE);
+	if ((bits = arith_encoded_size (ctx, METHOD_CM, buf, n)) < best_bits) {
+	    best_bits = bits;
+	    best = METHOD_CM;
+	}
+
+	for (i=0; i<DICT_BUILTINS + 1; i++) {
+	    int		d = (i < DICT_BUILTINS)
+					? i : ctx->ctx_compress_dict;
+
+	    if (d < DICT_FILE_ID && i == DICT_BUILTINS)
+		break;			/* No dictionary file */
+
+	    dict_select (ctx, d);
+	    if ((bits = arith_encoded_size (ctx, METHOD_DICT, buf, n)) >= 0
+				&& bits + dict_id_bits (d) < best_bits) {
+		best_bits = bits + dict_id_bits (d);
+		best = METHOD_DICT;
+		best_dict = d;
+	    }
+	}
+
+	*dict = best_dict;
+
+	return (best);
+}
+
+
+/*
+ * Compress the buffered message with the smallest method, preceded
+ * by its tag unless the payload header records it. The tag is written
+ * even if Huffman coding or no compression is chosen.
+ */
+
+static BOOL
+compress_auto_flush (
+	CONTEXT		*ctx,
+	FILE		*inf,
+	FILE		*outf
+) {
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+	int		dict, id = compress_auto_choose (ctx, &dict);
+
+	if (!ctx->ctx_quiet_flag)
+	    fprintf (stderr, "Selected compression method %s\n",
+						compress_method_name (id));
+
+	compress_method_set (ctx, id);
+	if (id == METHOD_DICT)
+	    cs->cs_dict = dict;
+
+	compress_stage_select (ctx);
+
+	if (!compress_tag_write (ctx, inf, outf))
+	    return (FALSE);
+
+	return (compress_bytes (ctx, cs->cs_buf, cs->cs_buf_len, inf, outf));
 }
 
 
@@ -95,16 +669,40 @@ compress_bit (
 
 BOOL
 compress_flush (
+	CONTEXT		*ctx,
 	FILE		*inf,
 	FILE		*outf
 ) {
-	if (compress_bit_count != 0 && !quiet_flag)
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+
+	if (cs->cs_bit_count != 0 && !ctx->ctx_quiet_flag)
 	    fprintf (stderr, "Warning: residual of %d bits not compressed\n",
-							compress_bit_count);
+							cs->cs_bit_count);
 
-	if (compress_bits_out > 0 && !quiet_flag) {
-	    double	cpc = (double) (compress_bits_in - compress_bits_out)
-					/ (double) compress_bits_in * 100.0;
+	if (cs->cs_flag && cs->cs_method == METHOD_AUTO
+				&& !compress_auto_flush (ctx, inf, outf))
+	    return (FALSE);
+
+		/* An empty message still has its tag */
+	if (!compress_tag_write (ctx, inf, outf))
+	    return (FALSE);
+
+	if (cs->cs_flag && cs->cs_method == METHOD_DICT
+		&& (!encrypt_word (ctx, cs->cs_dict, DICT_ID_BITS, inf, outf)
+		    || (cs->cs_dict >= DICT_FILE_ID
+			&& !encrypt_word (ctx, dict_check (ctx),
+					DICT_CHECK_BITS, inf, outf))))
+	    return (FALSE);
+
+	if (cs->cs_flag && cs->cs_method != METHOD_HUFFMAN) {
+	    if (!arith_encode_flush (ctx, inf, outf))
+		return (FALSE);
+	    cs->cs_bits_out = arith_encoded_bits (ctx);
+	}
+
+	if (cs->cs_bits_out > 0 && !ctx->ctx_quiet_flag) {
+	    double	cpc = (double) (cs->cs_bits_in - cs->cs_bits_out)
+					/ (double) cs->cs_bits_in * 100.0;
 
 	    if (cpc < 0.0)
 		fprintf (stderr,
@@ -114,160 +712,489 @@ compress_flush (
 		fprintf (stderr, "Compressed by %.2f%%\n", cpc);
 	}
 
-	return (encrypt_flush (inf, outf));
+	return (encrypt_flush (ctx, inf, outf));
 }
 
 
 /*
- * Local variables used for output.
+ * Write out uncompressed bytes.
  */
 
-static int	output_bit_count;
-static int	output_value;
+static BOOL
+output_bytes (
+	const unsigned char	*buf,
+	int			n,
+	FILE			*outf
+) {
+	if (n > 0 && fwrite (buf, 1, n, outf) != n) {
+	    perror ("Output file");
+	    return (FALSE);
+	}
+
+	return (TRUE);
+}
 
 
 /*
- * Initialize the output variables.
+ * Build the decoding table for a Huffman code table.
+ * Returns NULL if memory runs out.
+ */
+
+static HUFF_ENTRY *
+huff_decode_build (
+	int		table,
+	int		*max_length
+) {
+	const HUFF_CODE	*huff_codes_t = huff_codes[table];
+	HUFF_ENTRY	*huff_decode;
+	int		sub_bits[1 << HUFF_ROOT_BITS];
+	int		i, j, size = 1 << HUFF_ROOT_BITS;
+	int		huff_max_length = 0;
+
+	for (i=0; i < (1 << HUFF_ROOT_BITS); i++)
+	    sub_bits[i] = 0;
+
+	for (i=0; i<256; i++) {
+	    int		len = huff_codes_t[i].hc_length;
+
+	    if (len > huff_max_length)
+		huff_max_length = len;
+
+	    if (len > HUFF_ROOT_BITS) {
+		int	p = huff_codes_t[i].hc_code >> (len - HUFF_ROOT_BITS);
+
+		if (len - HUFF_ROOT_BITS > sub_bits[p])
+		    sub_bits[p] = len - HUFF_ROOT_BITS;
+	    }
+	}
+
+	for (i=0; i < (1 << HUFF_ROOT_BITS); i++)
+	    if (sub_bits[i] > 0)
+		size += 1 << sub_bits[i];
+
+	if ((huff_decode = (HUFF_ENTRY *) calloc (size,
+					sizeof (HUFF_ENTRY))) == NULL) {
+	    fprintf (stderr, "Out of memory for Huffman table.\n");
+	    return (NULL);
+	}
+
+		/* Link the subtables from the root */
+	size = 1 << HUFF_ROOT_BITS;
+	for (i=0; i < (1 << HUFF_ROOT_BITS); i++)
+	    if (sub_bits[i] > 0) {
+		huff_decode[i].he_symbol = -1;
+		huff_decode[i].he_length = sub_bits[i];
+		huff_decode[i].he_sub = size;
+		size += 1 << sub_bits[i];
+	    }
+
+		/* Fill every entry whose index starts with each code */
+	for (i=0; i<256; i++) {
+	    uint32_t	code = huff_codes_t[i].hc_code;
+	    int		len = huff_codes_t[i].hc_length;
+	    int		first, n;
+
+	    if (len <= HUFF_ROOT_BITS) {
+		first = code << (HUFF_ROOT_BITS - len);
+		n = 1 << (HUFF_ROOT_BITS - len);
+	    } else {
+		int	rest = len - HUFF_ROOT_BITS;
+		int	p = code >> rest;
+
+		first = huff_decode[p].he_sub + ((code & ((1 << rest) - 1))
+						<< (sub_bits[p] - rest));
+		n = 1 << (sub_bits[p] - rest);
+	    }
+
+	    for (j=0; j<n; j++) {
+		huff_decode[first + j].he_symbol = i;
+		huff_decode[first + j].he_length = len;
+	    }
+	}
+
+	*max_length = huff_max_length;
+
+	return (huff_decode);
+}
+
+
+/*
+ * Build the shared decoding tables.
  */
 
 static void
-output_init (void)
+huff_decode_init (void)
 {
-	output_bit_count = 0;
-	output_value = 0;
+	int		t;
+
+	for (t=0; t<HUFF_TABLES; t++)
+	    huff_decode_tables[t] = huff_decode_build (t, &huff_max_lengths[t]);
 }
 
 
 /*
- * Output a single bit.
+ * Return the shared decoding table for a Huffman code table, building
+ * the tables if no context has yet.
+ * Returns NULL if memory ran out when they were built.
  */
 
-static BOOL
-output_bit (
-	int		bit,
-	FILE		*outf
+static const HUFF_ENTRY *
+huff_decode_get (
+	int		table
 ) {
-	output_value = (output_value << 1) | bit;
+#ifdef HUFF_ONCE
+	pthread_once (&huff_decode_once, huff_decode_init);
+#else
+	if (!huff_decode_built) {
+	    huff_decode_init ();
+	    huff_decode_built = TRUE;
+	}
+#endif
 
-	if (++output_bit_count == 8) {
-	    if (fputc (output_value, outf) == EOF) {
-		perror ("Output file");
-		return (FALSE);
-	    }
+	return (huff_decode_tables[table]);
+}
 
-	    output_value = 0;
-	    output_bit_count = 0;
+
+/*
+ * Look up the code at the top of the n-bit window of input.
+ * If fewer bits than a full code are available, the window is
+ * padded with zeroes.
+ */
+
+static const HUFF_ENTRY *
+huff_lookup (
+	const HUFF_ENTRY	*huff_decode,
+	uint64_t		window,
+	int			n
+) {
+	const HUFF_ENTRY	*he;
+	int			sb;
+
+	he = &huff_decode[n >= HUFF_ROOT_BITS
+			? (window >> (n - HUFF_ROOT_BITS)) & ((1 << HUFF_ROOT_BITS) - 1)
+			: (window << (HUFF_ROOT_BITS - n)) & ((1 << HUFF_ROOT_BITS) - 1)];
+
+	if (he->he_symbol >= 0)
+	    return (he);
+
+	sb = he->he_length;
+	n -= HUFF_ROOT_BITS;
+
+	return (&huff_decode[he->he_sub + (n >= sb
+			? (window >> (n - sb)) & ((1 << sb) - 1)
+			: (window << (sb - n)) & ((1 << sb) - 1))]);
+}
+
+
+/*
+ * Initialize the uncompression routines.
+ */
+
+void
+uncompress_init (
+	CONTEXT		*ctx
+) {
+	compress_method_reset (ctx);
+	ctx->ctx_compress->cs_uncompress_nbits = 0;
+}
+
+
+/*
+ * Uncompress a span of bits.
+ */
+
+BOOL
+uncompress_span (
+	CONTEXT		*ctx,
+	const uint64_t	*words,
+	int		nbits,
+	FILE		*outf
+) {
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+
+	if (nbits > EPI_MAX_BITS - cs->cs_uncompress_nbits) {
+	    fprintf (stderr, "Error: compressed data is too long\n");
+	    return (FALSE);
 	}
 
+	if (nbits > 0)
+	    span_copy (cs->cs_uncompress_words, cs->cs_uncompress_nbits,
+							words, 0, nbits);
+	cs->cs_uncompress_nbits += nbits;
+
 	return (TRUE);
 }
 
 
 /*
- * Flush the contents of the output routines.
+ * Uncompress a single bit.
+ */
+
+BOOL
+uncompress_bit (
+	CONTEXT		*ctx,
+	int		bit,
+	FILE		*outf
+) {
+	uint64_t	word = (uint64_t) bit << 63;
+
+	return (uncompress_span (ctx, &word, 1, outf));
+}
+
+
+/*
+ * Output the message bits from bit pos up to end, which were not
+ * compressed.
  */
 
 static BOOL
-output_flush (
+uncompress_none (
+	CONTEXT		*ctx,
+	int		pos,
+	int		end,
 	FILE		*outf
 ) {
-	if (output_bit_count > 2 && !quiet_flag)
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+	int		i, n = (end - pos) / 8;
+
+	for (i=0; i<n; i++)
+	    cs->cs_uncompress_buf[i] = span_read (cs->cs_uncompress_words,
+							pos + i * 8, 8);
+
+	if (!output_bytes (cs->cs_uncompress_buf, n, outf))
+	    return (FALSE);
+
+	if ((end - pos) % 8 > 2 && !ctx->ctx_quiet_flag)
 	    fprintf (stderr, "Warning: residual of %d bits not output\n",
-							output_bit_count);
+							(end - pos) % 8);
 
 	return (TRUE);
 }
 
 
 /*
- * Local variables used for uncompression.
+ * Decode the bits of a span from bit *pos up to end with a Huffman
+ * table, into the uncompression buffer. Each code is looked up in a
+ * window of the bits that follow it, which is short of a full code
+ * only at the end, where the padding is left over.
+ * On return pos is at the first bit not decoded.
+ * Returns the number of bytes, or -1 if there is an invalid code.
  */
 
-static int	uncompress_bit_count;
-static char	uncompress_value[256];
+static int
+huff_decode_span (
+	COMPRESS_STATE	*cs,
+	int		table,
+	const uint64_t	*words,
+	int		*pos,
+	int		end
+) {
+	const HUFF_ENTRY	*huff_decode = huff_decode_get (table);
+	int		huff_max_length = huff_max_lengths[table];
+	int		n = 0;
+
+	while (*pos < end) {
+	    int			nw = end - *pos;
+	    const HUFF_ENTRY	*he;
+
+	    if (nw > huff_max_length)
+		nw = huff_max_length;
+	    he = huff_lookup (huff_decode, span_read (words, *pos, nw), nw);
+
+	    if (he->he_length == 0) {
+		if (nw < huff_max_length)		/* Padding */
+		    break;
+		return (-1);
+	    }
+
+	    if (he->he_length > nw)
+		break;
+
+	    cs->cs_uncompress_buf[n++] = he->he_symbol;
+	    *pos += he->he_length;
+	}
+
+	return (n);
+}
 
 
 /*
- * Initialize the uncompression routines.
+ * Decode the message bits from bit pos up to end with the current
+ * Huffman table.
  */
 
-void
-uncompress_init (void)
-{
-	uncompress_bit_count = 0;
+static BOOL
+uncompress_huffman (
+	CONTEXT		*ctx,
+	int		pos,
+	int		end,
+	FILE		*outf
+) {
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+	int		n;
+
+	if (huff_decode_get (cs->cs_table) == NULL)
+	    return (FALSE);
+
+	n = huff_decode_span (cs, cs->cs_table, cs->cs_uncompress_words,
+								&pos, end);
+	if (n < 0) {
+	    fprintf (stderr, "Error: invalid Huffman code\n");
+	    return (FALSE);
+	}
+
+	if (!output_bytes (cs->cs_uncompress_buf, n, outf))
+	    return (FALSE);
+
+	if (end - pos > 2 && !ctx->ctx_quiet_flag)
+	    fprintf (stderr, "Warning: residual of %d bits not uncompressed\n",
+								end - pos);
 
-	output_init ();
+	return (TRUE);
 }
 
 
 /*
- * Find the Huffman code string that matches.
+ * Decode the message bits from bit pos up to end with the arithmetic
+ * decoder.
  */
 
-static int
-huffcode_find (
-	const char	*str
+static BOOL
+uncompress_arith (
+	CONTEXT		*ctx,
+	int		pos,
+	int		end,
+	FILE		*outf
 ) {
-	int		i;
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+	uint64_t	words[SPAN_WORDS (EPI_MAX_BITS)];
+	int		n;
 
-	for (i=0; i<256; i++)
-	    if (strcmp (str, huffcodes[i]) == 0)
-		return (i);
+	span_copy (words, 0, cs->cs_uncompress_words, pos, end - pos);
 
-	return (-1);
+	n = arith_decode (ctx, cs->cs_method, words, end - pos,
+			cs->cs_uncompress_buf, UNCOMPRESS_MAX_BYTES);
+	if (n < 0) {
+	    fprintf (stderr, "Error: corrupt compressed data\n");
+	    return (FALSE);
+	}
+
+	return (output_bytes (cs->cs_uncompress_buf, n, outf));
 }
 
 
 /*
- * Uncompress a single bit.
+ * Flush the contents of the uncompression routines, uncompressing
+ * the message.
+ * Unless a payload header gave the method, every method but Huffman
+ * coding is preceded by a tag, and the message is uncompressed with
+ * the method in the tag. With the dictionary method the dictionary's
+ * ID comes next. Without them there is no message.
  */
 
 BOOL
-uncompress_bit (
-	int		bit,
+uncompress_flush (
+	CONTEXT		*ctx,
 	FILE		*outf
 ) {
-	int		code;
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+	int		pos = 0, end = cs->cs_uncompress_nbits;
 
-	if (!compress_flag)
-	    return (output_bit (bit, outf));
+	cs->cs_uncompress_nbits = 0;
 
-	uncompress_value[uncompress_bit_count++] = bit ? '1' : '0';
-	uncompress_value[uncompress_bit_count] = '\0';
+	if (compress_tagged (ctx)) {
+	    int		id;
 
-	if ((code = huffcode_find (uncompress_value)) >= 0) {
-	    int		i;
+	    if (end < HEADER_METHOD_BITS)
+		return (TRUE);
 
-	    for (i=0; i<8; i++) {
-		int	b = ((code & (128 >> i)) != 0) ? 1 : 0;
+	    id = span_read (cs->cs_uncompress_words, pos, HEADER_METHOD_BITS);
+	    pos += HEADER_METHOD_BITS;
 
-		if (!output_bit (b, outf))
-		    return (FALSE);
+	    if (!compress_method_set (ctx, id)) {
+		fprintf (stderr, "Unknown compression method %d.\n", id);
+		return (FALSE);
 	    }
-
-	    uncompress_bit_count = 0;
 	}
 
-	if (uncompress_bit_count >= 255) {
-	    fprintf (stderr, "Error: Huffman uncompress buffer overflow\n");
-	    return (FALSE);
+	if (cs->cs_flag && cs->cs_method == METHOD_DICT) {
+	    int		id;
+
+	    if (end - pos < DICT_ID_BITS)
+		return (TRUE);
+
+	    id = span_read (cs->cs_uncompress_words, pos, DICT_ID_BITS);
+	    if (end - pos < dict_id_bits (id))
+		return (TRUE);
+	    pos += DICT_ID_BITS;
+
+	    if (!dict_select (ctx, id))
+		return (FALSE);
+	    if (id >= DICT_FILE_ID) {
+		if (!dict_verify (ctx, span_read (cs->cs_uncompress_words,
+						pos, DICT_CHECK_BITS)))
+		    return (FALSE);
+		pos += DICT_CHECK_BITS;
+	    }
+	    cs->cs_dict = id;
 	}
 
-	return (TRUE);
+	if (!cs->cs_flag)
+	    return (uncompress_none (ctx, pos, end, outf));
+	if (cs->cs_method == METHOD_HUFFMAN)
+	    return (uncompress_huffman (ctx, pos, end, outf));
+
+	return (uncompress_arith (ctx, pos, end, outf));
 }
 
 
 /*
- * Flush the contents of the uncompression routines.
+ * Check that the bits of a message, compressed with the method of a
+ * payload header, would uncompress without error. Nothing is output
+ * or printed, so wrong keys can be weeded out quietly.
+ * Returns FALSE if they wouldn't.
  */
 
 BOOL
-uncompress_flush (
-	FILE		*outf
+uncompress_check (
+	CONTEXT		*ctx,
+	int		id,
+	const uint64_t	*words,
+	int		nbits
 ) {
-	if (uncompress_bit_count > 2 && !quiet_flag)
-	    fprintf (stderr, "Warning: residual of %d bits not uncompressed\n",
-							uncompress_bit_count);
+	COMPRESS_STATE	*cs = ctx->ctx_compress;
+	uint64_t	rest[SPAN_WORDS (EPI_MAX_BITS)];
+	int		pos = 0;
+
+	if (id == METHOD_NONE)
+	    return (TRUE);
+
+	if (id >= METHOD_HUFFMAN && id < METHOD_HUFFMAN + HUFF_TABLES)
+	    return (huff_decode_get (id - METHOD_HUFFMAN) != NULL
+			&& huff_decode_span (cs, id - METHOD_HUFFMAN, words,
+							&pos, nbits) >= 0);
+
+	if (id == METHOD_DICT) {
+	    int		dict, check = 0;
+
+	    if (nbits < DICT_ID_BITS)
+		return (TRUE);
+
+	    dict = span_read (words, 0, DICT_ID_BITS);
+	    if (nbits < dict_id_bits (dict))
+		return (TRUE);
+	    if (dict >= DICT_FILE_ID)
+		check = span_read (words, DICT_ID_BITS, DICT_CHECK_BITS);
+
+	    if (!dict_match (ctx, dict, check))
+		return (FALSE);
+	    dict_select (ctx, dict);
+	    pos = dict_id_bits (dict);
+	} else if (id != METHOD_RANGE && id != METHOD_CM)
+	    return (FALSE);
+
+	span_copy (rest, 0, words, pos, nbits - pos);
 
-	return (output_flush (outf));
+	return (arith_decode (ctx, id, rest, nbits - pos,
+			cs->cs_uncompress_buf, UNCOMPRESS_MAX_BYTES) >= 0);
 }
@@ -0,0 +1,74 @@
+/*
+ * Processing contexts for the gifshuffle steganography program.
+ * A context holds the options, and the state of each stage, for the
+ * carriers it processes. Contexts share only read-only coding tables,
+ * and the cache of password keys, which is locked.
+ */
+
+#include "gifshuf.h"
+#include "pcache.h"
+
+#include <stdlib.h>
+
+
+/*
+ * Create a context with the default options.
+ * Returns NULL if memory runs out.
+ */
+
+CONTEXT *
+context_create (void)
+{
+	CONTEXT		*ctx;
+
+	if ((ctx = (CONTEXT *) calloc (1, sizeof (CONTEXT))) == NULL) {
+	    fprintf (stderr, "Out of memory for context.\n");
+	    return (NULL);
+	}
+
+	ctx->ctx_compress_flag = FALSE;
+	ctx->ctx_quiet_flag = FALSE;
+	ctx->ctx_v1_flag = FALSE;
+	ctx->ctx_group_flag = FALSE;
+	ctx->ctx_block_flag = FALSE;
+	ctx->ctx_fixed_key_flag = FALSE;
+	ctx->ctx_header_flag = FALSE;
+	ctx->ctx_compress_method = METHOD_HUFFMAN;
+	ctx->ctx_compress_table = 0;
+	ctx->ctx_compress_dict = -1;
+
+	if ((ctx->ctx_encrypt = encrypt_state_create ()) == NULL
+		|| (ctx->ctx_compress = compress_state_create ()) == NULL
+		|| (ctx->ctx_encode = encode_state_create ()) == NULL
+		|| (ctx->ctx_arith = arith_state_create ()) == NULL
+		|| (ctx->ctx_dict = dict_state_create ()) == NULL) {
+	    fprintf (stderr, "Out of memory for context.\n");
+	    context_destroy (ctx);
+	    return (NULL);
+	}
+
+	return (ctx);
+}
+
+
+/*
+ * Destroy a context, releasing any keys it holds, and closing its
+ * palette cache.
+ */
+
+void
+context_destroy (
+	CONTEXT		*ctx
+) {
+	if (ctx == NULL)
+	    return;
+
+	encrypt_state_destroy (ctx->ctx_encrypt);
+	compress_state_destroy (ctx->ctx_compress);
+	encode_state_destroy (ctx->ctx_encode);
+	arith_state_destroy (ctx->ctx_arith);
+	dict_state_destroy (ctx->ctx_dict);
+	pcache_close (ctx->ctx_pcache);
+
+	free (ctx);
+}
@@ -0,0 +1,288 @@
+/*
+ * Preset dictionaries for the gifshuffle steganography program.
+ * A dictionary holds text that messages are likely to share, such as
+ * JSON keys or URL prefixes, so that the dictionary compression method
+ * can code it as a match rather than byte by byte.
+ * Some dictionaries are built in, and one can be loaded from a file.
+ */
+
+#include "gifshuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+ * The built-in dictionaries. A dictionary's position is its ID, which
+ * is stored in the payload, so new ones must only be added at the end.
+ * Matches near the end of a dictionary are cheapest, so the most common
+ * strings come last.
+ */
+
+static const struct {
+	const char	*dd_name;
+	const char	*dd_text;
+} dict_builtins[DICT_BUILTINS] = {
+	{"json",
+	    "{\"type\":\"\",\"value\":\"\",\"data\":{\"items\":[{\"key\":\""
+	    "\"message\":\"\",\"error\":null,\"code\":\",\"count\":"
+	    "\"description\":\"\",\"title\":\"\",\"url\":\"https://"
+	    "\"address\":{\"street\":\"\",\"city\":\"\",\"country\":\""
+	    "\"postcode\":\"\",\"phone\":\"+1\",\"email\":\"@example.com\""
+	    "\"first_name\":\"\",\"last_name\":\"\",\"name\":\""
+	    "\"created\":\"\",\"updated\":\"\",\"timestamp\":\",\"date\":\""
+	    "\"enabled\":false,\"active\":true,\"ok\":true,\"status\":\""
+	    "\"score\":\"tags\":[\"\",\"\"],\"user\":\"\",\"ts\":\"2025-"
+	    "\"},{\"id\":\"},\"id\":"},
+	{"url",
+	    "mailto:ftp://file:///index.html.php.aspx.jsp.json.xml.pdf.png"
+	    ".jpg.gif.css.js/favicon.ico/robots.txt/login/logout/account"
+	    "/profile/settings/search?q=/download/upload/static/images"
+	    "/assets/docs/blog/news/products/items/orders/users/api/v2/"
+	    "&utm_source=&utm_medium=&utm_campaign=&lang=en&ref=&token="
+	    "?id=&page=&sort=&limit=&offset=&type=&key=.co.uk/.io/.de/"
+	    ".net/.org/.com/https://api.https://cdn.http://www."
+	    "https://www."},
+	{"english",
+	    "because before between could every first found great house "
+	    "little never other people place right should small still "
+	    "their there these thing think those three through under "
+	    "water where which while world would years about after again "
+	    "also been come from have into know like made make more most "
+	    "much must only over said same some such take than them then "
+	    "they this time very well were what when will with your "
+	    "and are but can for had has her him his how its may new not "
+	    "now one our out see she two use was way who you "
+	    "I am at be by do go he if in is it me my no of on or so to "
+	    "up us we. The of the and the in the to the "}
+};
+
+
+/*
+ * A dictionary loaded from a file.
+ */
+
+struct dict_state_struct {
+	unsigned char	ds_text[DICT_MAX_BYTES];
+	int		ds_len;
+	int		ds_id;		/* -1 if none is loaded */
+	int		ds_check;
+};
+
+
+/*
+ * Create the dictionary state of a context, with no file loaded.
+ * Returns NULL if memory runs out.
+ */
+
+DICT_STATE *
+dict_state_create (void)
+{
+	DICT_STATE	*ds;
+
+	if ((ds = (DICT_STATE *) malloc (sizeof (DICT_STATE))) == NULL)
+	    return (NULL);
+
+	ds->ds_len = 0;
+	ds->ds_id = -1;
+	ds->ds_check = 0;
+
+	return (ds);
+}
+
+
+/*
+ * Destroy the dictionary state of a context.
+ */
+
+void
+dict_state_destroy (
+	DICT_STATE	*ds
+) {
+	free (ds);
+}
+
+
+/*
+ * Load a dictionary from a file, and derive its ID and check value from
+ * a hash of its contents, so that extraction can tell if it has the
+ * wrong one.
+ * Returns the ID, or -1 on error.
+ */
+
+static int
+dict_load (
+	DICT_STATE	*ds,
+	const char	*path
+) {
+	FILE		*fp;
+	uint64_t	hash = 0xcbf29ce484222325ULL;
+	int		i;
+
+	if ((fp = fopen (path, "rb")) == NULL) {
+	    perror (path);
+	    return (-1);
+	}
+
+	ds->ds_len = fread (ds->ds_text, 1, DICT_MAX_BYTES, fp);
+	if (ferror (fp) != 0) {
+	    perror (path);
+	    fclose (fp);
+	    return (-1);
+	}
+
+	if (fgetc (fp) != EOF) {
+	    fprintf (stderr, "Dictionary %s is larger than %d bytes.\n",
+							path, DICT_MAX_BYTES);
+	    fclose (fp);
+	    return (-1);
+	}
+	fclose (fp);
+
+	for (i=0; i<ds->ds_len; i++)
+	    hash = (hash ^ ds->ds_text[i]) * 0x100000001b3ULL;
+
+	ds->ds_id = DICT_FILE_ID
+			+ (hash >> 32) % ((1 << DICT_ID_BITS) - DICT_FILE_ID);
+	ds->ds_check = hash & ((1 << DICT_CHECK_BITS) - 1);
+
+	return (ds->ds_id);
+}
+
+
+/*
+ * Find a built-in dictionary by name, or else load one from the file
+ * of that name.
+ * Returns the dictionary's ID, or -1 on error.
+ */
+
+int
+dict_find (
+	CONTEXT		*ctx,
+	const char	*name
+) {
+	int		i;
+
+	for (i=0; i<DICT_BUILTINS; i++)
+	    if (strcmp (name, dict_builtins[i].dd_name) == 0)
+		return (i);
+
+	return (dict_load (ctx->ctx_dict, name));
+}
+
+
+/*
+ * Return the name of a dictionary ID.
+ */
+
+const char *
+dict_name (
+	int		id
+) {
+	if (id >= 0 && id < DICT_BUILTINS)
+	    return (dict_builtins[id].dd_name);
+
+	return ("file");
+}
+
+
+/*
+ * Make a dictionary the one used by the dictionary method.
+ * Returns FALSE if it isn't available.
+ */
+
+BOOL
+dict_select (
+	CONTEXT		*ctx,
+	int		id
+) {
+	const DICT_STATE	*ds = ctx->ctx_dict;
+
+	if (id >= 0 && id < DICT_BUILTINS) {
+	    arith_dictionary_set (ctx, (const unsigned char *)
+			dict_builtins[id].dd_text,
+			strlen (dict_builtins[id].dd_text));
+	    return (TRUE);
+	}
+
+	if (id >= DICT_FILE_ID && id == ds->ds_id) {
+	    arith_dictionary_set (ctx, ds->ds_text, ds->ds_len);
+	    return (TRUE);
+	}
+
+	if (id >= DICT_FILE_ID && ds->ds_id < 0)
+	    fprintf (stderr, "Message needs a dictionary file (-D).\n");
+	else if (id >= DICT_FILE_ID)
+	    fprintf (stderr, "Dictionary file does not match the message.\n");
+	else
+	    fprintf (stderr, "Unknown dictionary %d.\n", id);
+
+	return (FALSE);
+}
+
+
+/*
+ * Check, without printing anything, whether the dictionary with an ID
+ * and, for a file, a check value, is available.
+ */
+
+BOOL
+dict_match (
+	const CONTEXT	*ctx,
+	int		id,
+	int		check
+) {
+	const DICT_STATE	*ds = ctx->ctx_dict;
+
+	if (id >= 0 && id < DICT_BUILTINS)
+	    return (TRUE);
+
+	return (id >= DICT_FILE_ID && id == ds->ds_id
+					&& check == ds->ds_check);
+}
+
+
+/*
+ * Return the number of bits a dictionary's ID, and the check value of
+ * a file, take ahead of the compressed message.
+ */
+
+int
+dict_id_bits (
+	int		id
+) {
+	return ((id >= DICT_FILE_ID) ? DICT_ID_BITS + DICT_CHECK_BITS
+							: DICT_ID_BITS);
+}
+
+
+/*
+ * Return the check value of the dictionary file loaded.
+ */
+
+int
+dict_check (
+	const CONTEXT	*ctx
+) {
+	return (ctx->ctx_dict->ds_check);
+}
+
+
+/*
+ * Check that the check value stored with a message matches the
+ * dictionary file loaded.
+ * Returns FALSE if it doesn't.
+ */
+
+BOOL
+dict_verify (
+	const CONTEXT	*ctx,
+	int		check
+) {
+	if (check == ctx->ctx_dict->ds_check)
+	    return (TRUE);
+
+	fprintf (stderr, "Dictionary file does not match the message.\n");
+
+	return (FALSE);
+}
@@ -7,110 +7,495 @@
 #include "gifshuf.h"
 #include "epi.h"
 #include "gif.h"
+#include "pcache.h"
+#include "facttab.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 
 /*
- * An RGB with position information and possibly its encrypted ciphertext.
+ * The unique colours of a colourmap, held as parallel arrays.
+ * Colours are stored in order of first appearance, so a colour's index
+ * is also its position in the colourmap. The sort keys are either the
+ * packed RGB values or the big-endian encrypted colours, and pal_order
+ * lists the colour indices sorted by key. The natural RGB order may
+ * also be known in advance from the palette cache.
  */
 
 typedef struct {
-	int		pos;
-	RGB		rgb;
-	unsigned char	ctext[8];
-} CMAP_INFO;
+	int		pal_ncols;
+	RGB		pal_rgb[256];
+	uint64_t	pal_key[256];
+	unsigned char	pal_order[256];
+	BOOL		pal_natural_valid;
+	unsigned char	pal_natural[256];	/* Order by RGB, if known */
+} PALETTE;
 
 
 /*
- * Local variables used for encoding.
+ * Cache of sorted palette orders, indexed by a fingerprint of the
+ * palette. When carriers share a palette and a key, the encrypted
+ * ordering of the whole palette can be reused. Entries are tagged with
+ * the key's serial number, and hold the whole palette for comparison,
+ * so a hit can't come from another key or palette.
  */
 
-static int	encode_bit_count;
-static EPI	encode_bits;
+#define ORDER_CACHE_SIZE	8
+
+typedef struct {
+	BOOL		oc_valid;
+	uint64_t	oc_key_id;
+	int		oc_ncols;
+	RGB		oc_rgb[256];
+	uint64_t	oc_key[256];
+	unsigned char	oc_order[256];
+} ORDER_CACHE_ENTRY;
+
+
+/*
+ * The encoding state of a context. The bits to be encoded are stored
+ * until flushed.
+ */
+
+struct encode_state_struct {
+	int		en_bit_count;
+	uint64_t	en_words[SPAN_WORDS (EPI_MAX_BITS)];
+	EPI		en_bits;
+
+	ORDER_CACHE_ENTRY	en_order_cache[ORDER_CACHE_SIZE];
+};
+
+
+/*
+ * A set of colourmap slots, held as a 256-bit bitmap so that rank and
+ * select can be done with population counts rather than by shuffling
+ * array entries around.
+ */
+
+typedef struct {
+	uint64_t	ss_words[4];
+} SLOT_SET;
 
 
 /*
- * Compare two RGB values.
+ * Count the bits set in a 64-bit word.
  */
 
 static int
-rgb_cmp (
-	const RGB	*r1,
-	const RGB	*r2
+popcount64 (
+	uint64_t	x
 ) {
-	int		v1 = (r1->r << 16) | (r1->g << 8) | r1->b;
-	int		v2 = (r2->r << 16) | (r2->g << 8) | r2->b;
+#ifdef __GNUC__
+	return (__builtin_popcountll (x));
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return ((int) ((x * 0x0101010101010101ULL) >> 56));
+#endif
+}
 
-	return (v1 - v2);
+
+/*
+ * Initialize a slot set to contain slots [0, n-1].
+ */
+
+static void
+slot_set_fill (
+	SLOT_SET	*ss,
+	int		n
+) {
+	int		i;
+
+	for (i=0; i<4; i++) {
+	    if (n >= 64)
+		ss->ss_words[i] = ~(uint64_t) 0;
+	    else if (n > 0)
+		ss->ss_words[i] = ((uint64_t) 1 << n) - 1;
+	    else
+		ss->ss_words[i] = 0;
+	    n -= 64;
+	}
 }
 
 
 /*
- * Compare two colourmap info values.
+ * Add a slot to the set.
+ */
+
+static void
+slot_set_add (
+	SLOT_SET	*ss,
+	int		slot
+) {
+	ss->ss_words[slot >> 6] |= (uint64_t) 1 << (slot & 63);
+}
+
+
+/*
+ * Remove a slot from the set.
+ */
+
+static void
+slot_set_remove (
+	SLOT_SET	*ss,
+	int		slot
+) {
+	ss->ss_words[slot >> 6] &= ~((uint64_t) 1 << (slot & 63));
+}
+
+
+/*
+ * Return the number of slots in the set below the given slot.
  */
 
 static int
-cmap_cmp (
-	const void	*p1,
-	const void	*p2
+slot_set_rank (
+	const SLOT_SET	*ss,
+	int		slot
 ) {
-	return (rgb_cmp (&((CMAP_INFO *) p1)->rgb, &((CMAP_INFO *) p2)->rgb));
+	int		i, w = slot >> 6, n = 0;
+
+	for (i=0; i<w; i++)
+	    n += popcount64 (ss->ss_words[i]);
+
+	if ((slot & 63) != 0)
+	    n += popcount64 (ss->ss_words[w]
+				& (((uint64_t) 1 << (slot & 63)) - 1));
+
+	return (n);
 }
 
 
 /*
- * Compare two colourmap info values by their encrypted values.
+ * Return the k'th slot (counting from zero) in the set.
  */
 
 static int
-cmap_encrypt_cmp (
-	const void	*p1,
-	const void	*p2
+slot_set_select (
+	const SLOT_SET	*ss,
+	int		k
+) {
+	int		i, n;
+	uint64_t	x;
+
+	for (i=0; i<3; i++) {
+	    if (k < (n = popcount64 (ss->ss_words[i])))
+		break;
+	    k -= n;
+	}
+
+	x = ss->ss_words[i];
+	for (n = 0; k >= popcount64 (x & 0xff); n += 8) {
+	    k -= popcount64 (x & 0xff);
+	    x >>= 8;
+	}
+
+	for (;; n++, x >>= 1)
+	    if ((x & 1) != 0 && k-- == 0)
+		break;
+
+	return (i * 64 + n);
+}
+
+
+/*
+ * Pack an RGB value into a 24-bit integer.
+ */
+
+static uint32_t
+rgb_pack (
+	const RGB	*rgb
+) {
+	return (((uint32_t) rgb->r << 16) | ((uint32_t) rgb->g << 8) | rgb->b);
+}
+
+
+/*
+ * Find the unique colours in a colourmap.
+ * Duplicates are found with a small open-addressed hash table of
+ * packed RGB values. The entry where each unique colour first appears
+ * is recorded in pi.
+ */
+
+static void
+palette_scan (
+	const GIFINFO	*gi,
+	PALETTE		*pal,
+	PCACHE_INFO	*pi
 ) {
-	const CMAP_INFO		*c1 = (const CMAP_INFO *) p1;
-	const CMAP_INFO		*c2 = (const CMAP_INFO *) p2;
-	unsigned int		i;
+	uint32_t	htab[512];
+	int		i, n = 0;
+
+	for (i=0; i<512; i++)
+	    htab[i] = 0;
 
-	for (i=0; i<8; i++)
-	    if (c1->ctext[i] != c2->ctext[i])
-		return ((int) c1->ctext[i] - (int) c2->ctext[i]);
+	for (i=0; i<gi->gi_num_colours; i++) {
+	    const RGB	*rgb = &gi->gi_colours[i];
+	    uint32_t	v = rgb_pack (rgb) + 1;		/* Zero is empty */
+	    int		h = (int) ((uint32_t) (v * 0x9e3779b1U) >> 23);
 
-	return (0);
+	    while (htab[h] != 0 && htab[h] != v)
+		h = (h + 1) & 511;
+
+	    if (htab[h] == 0) {
+		htab[h] = v;
+		pi->pi_first[n] = i;
+		pal->pal_rgb[n++] = *rgb;
+	    }
+	}
+
+	pal->pal_ncols = n;
+	pi->pi_nunique = n;
 }
 
 
 /*
- * Return the unique colours from a colourmap.
- * Put the non-unique colours at the top of the array.
+ * Sort n indices into keys with an LSD radix sort on the bottom
+ * nbytes bytes of each key. Passes where every key has the same byte
+ * are skipped.
+ */
+
+static void
+radix_sort (
+	const uint64_t	*keys,
+	int		n,
+	int		nbytes,
+	unsigned char	*order
+) {
+	unsigned char	tmp[256];
+	unsigned char	*src = order, *dst = tmp;
+	int		i, b;
+
+	for (i=0; i<n; i++)
+	    order[i] = i;
+
+	for (b = 0; b < nbytes; b++) {
+	    int		count[257];
+	    int		shift = b * 8;
+	    unsigned char	*t;
+
+	    for (i=0; i<257; i++)
+		count[i] = 0;
+	    for (i=0; i<n; i++)
+		count[((keys[src[i]] >> shift) & 0xff) + 1]++;
+
+	    if (n == 0 || count[((keys[src[0]] >> shift) & 0xff) + 1] == n)
+		continue;
+
+	    for (i=0; i<256; i++)
+		count[i + 1] += count[i];
+	    for (i=0; i<n; i++)
+		dst[count[(keys[src[i]] >> shift) & 0xff]++] = src[i];
+
+	    t = src;
+	    src = dst;
+	    dst = t;
+	}
+
+	if (src != order)
+	    for (i=0; i<n; i++)
+		order[i] = src[i];
+}
+
+
+/*
+ * Return the number of bits in the largest number that can be encoded
+ * in a colourmap with ncols unique colours, (ncols! - 1).
  */
 
 static int
-unique_colours (
-	const RGB	*cols,
-	int		ncols,
-	CMAP_INFO	*ci_array
+colourmap_max_bits (
+	int		ncols
 ) {
-	int		i, n = 0, top = 0;
+	if (ncols < 3)		/* ncols! is a power of two */
+	    return (fact_log2[ncols]);
 
-	for (i=0; i<ncols; i++) {
-	    int		j;
-	    BOOL	unique = TRUE;
-	    const RGB	*r = &cols[i];
+	return (fact_log2[ncols] + 1);
+}
 
-	    for (j=0; j<i; j++)
-		if (rgb_cmp (r, &cols[j]) == 0) {
-		    unique = FALSE;
-		    break;
-		}
 
-	    if (unique)
-		ci_array[n++].rgb = cols[i];
-	    else
-		ci_array[ncols - ++top].rgb = cols[i];
+/*
+ * Load the unique colours from a colourmap.
+ * The context's palette cache, if any, is consulted first. On a miss
+ * the colourmap is scanned, and the results are added to the cache.
+ */
+
+static void
+palette_load (
+	const CONTEXT	*ctx,
+	const GIFINFO	*gi,
+	PALETTE		*pal
+) {
+	PCACHE_INFO	pi;
+	int		i, n;
+
+	if (pcache_lookup (ctx->ctx_pcache, gi, &pi)) {
+	    n = pal->pal_ncols = pi.pi_nunique;
+	    for (i=0; i<n; i++)
+		pal->pal_rgb[i] = gi->gi_colours[pi.pi_first[i]];
+
+	    memcpy (pal->pal_natural, pi.pi_order, n);
+	    pal->pal_natural_valid = TRUE;
+	    return;
 	}
 
-	return (n);
+	palette_scan (gi, pal, &pi);
+	pal->pal_natural_valid = FALSE;
+
+	if (pcache_active (ctx->ctx_pcache)) {
+	    n = pal->pal_ncols;
+	    for (i=0; i<n; i++)
+		pal->pal_key[i] = rgb_pack (&pal->pal_rgb[i]);
+	    radix_sort (pal->pal_key, n, 3, pal->pal_natural);
+	    pal->pal_natural_valid = TRUE;
+
+	    memcpy (pi.pi_order, pal->pal_natural, n);
+
+	    pcache_store (ctx->ctx_pcache, gi, &pi);
+	}
+}
+
+
+/*
+ * Calculate a fingerprint of a palette's colours.
+ */
+
+static uint64_t
+palette_fingerprint (
+	const PALETTE	*pal
+) {
+	uint64_t	h = 0xcbf29ce484222325ULL ^ pal->pal_ncols;
+	int		i;
+
+	for (i=0; i<pal->pal_ncols; i++) {
+	    h = (h ^ rgb_pack (&pal->pal_rgb[i])) * 0x100000001b3ULL;
+	    h ^= h >> 29;
+	}
+
+	return (h);
+}
+
+
+/*
+ * Copy a palette's colours into an array of 3-byte RGB triples.
+ */
+
+static void
+palette_rgb_bytes (
+	const PALETTE	*pal,
+	unsigned char	*rgb
+) {
+	int		i;
+
+	for (i=0; i<pal->pal_ncols; i++) {
+	    rgb[i * 3] = pal->pal_rgb[i].r;
+	    rgb[i * 3 + 1] = pal->pal_rgb[i].g;
+	    rgb[i * 3 + 2] = pal->pal_rgb[i].b;
+	}
+}
+
+
+/*
+ * Set a palette's sort keys from its colours' 8-byte ciphertexts,
+ * read as big-endian numbers.
+ */
+
+static void
+palette_cipher_keys (
+	PALETTE			*pal,
+	const unsigned char	*ctext
+) {
+	int			i, j;
+
+	for (i=0; i<pal->pal_ncols; i++) {
+	    uint64_t		k = 0;
+
+	    for (j=0; j<8; j++)
+		k = (k << 8) | ctext[i * 8 + j];
+	    pal->pal_key[i] = k;
+	}
+}
+
+
+/*
+ * Sort a palette into its natural order, by RGB value.
+ */
+
+static void
+palette_sort_natural (
+	PALETTE		*pal
+) {
+	int		i, n = pal->pal_ncols;
+
+	if (pal->pal_natural_valid) {
+	    memcpy (pal->pal_order, pal->pal_natural, n);
+	    return;
+	}
+
+	for (i=0; i<n; i++)
+	    pal->pal_key[i] = rgb_pack (&pal->pal_rgb[i]);
+	radix_sort (pal->pal_key, n, 3, pal->pal_order);
+}
+
+
+/*
+ * Sort the palette, either by natural RGB order or by the order of
+ * the encrypted colours.
+ */
+
+static void
+palette_sort (
+	CONTEXT		*ctx,
+	PALETTE		*pal
+) {
+	int		n = pal->pal_ncols;
+
+	if (encrypting_colourmap (ctx)) {
+	    uint64_t		key_id = encrypt_key_id (ctx);
+	    ORDER_CACHE_ENTRY	*oc = &ctx->ctx_encode->en_order_cache[
+		(palette_fingerprint (pal) ^ key_id) % ORDER_CACHE_SIZE];
+	    unsigned char	rgb[256 * 3], ctext[256 * 8];
+
+	    if (oc->oc_valid && oc->oc_key_id == key_id && oc->oc_ncols == n
+		    && memcmp (oc->oc_rgb, pal->pal_rgb, n * sizeof (RGB)) == 0) {
+		memcpy (pal->pal_key, oc->oc_key, n * sizeof (uint64_t));
+		memcpy (pal->pal_order, oc->oc_order, n);
+		return;
+	    }
+
+		/* Encrypt the whole palette in one batch */
+	    palette_rgb_bytes (pal, rgb);
+	    encrypt_colours (ctx, n, rgb, ctext);
+	    palette_cipher_keys (pal, ctext);
+	    radix_sort (pal->pal_key, n, 8, pal->pal_order);
+
+	    oc->oc_valid = TRUE;
+	    oc->oc_key_id = key_id;
+	    oc->oc_ncols = n;
+	    memcpy (oc->oc_rgb, pal->pal_rgb, n * sizeof (RGB));
+	    memcpy (oc->oc_key, pal->pal_key, n * sizeof (uint64_t));
+	    memcpy (oc->oc_order, pal->pal_order, n);
+	} else
+	    palette_sort_natural (pal);
+}
+
+
+/*
+ * Return the number of unique colours in a colourmap.
+ */
+
+static int
+unique_colour_count (
+	const CONTEXT	*ctx,
+	const GIFINFO	*gi
+) {
+	PALETTE		pal;
+
+	palette_load (ctx, gi, &pal);
+
+	return (pal.pal_ncols);
 }
 
 
@@ -121,19 +506,41 @@ unique_colours (
 
 static void
 colourmap_max_storage (
-	const GIFINFO	*gi,
+	int		ncols,
 	EPI		*epi
 ) {
-	int		i, ncols = 0;
-	CMAP_INFO	dummy[256];
+	epi_set_words (epi, fact_minus_one[ncols], FACT_LIMBS);
+}
 
-	ncols = unique_colours (gi->gi_colours, gi->gi_num_colours, dummy);
 
-	epi_set (epi, 1);
-	for (i=2; i<=ncols; i++)
-	    epi_multiply (epi, i);
+/*
+ * Place n colours from the sorted palette, starting at sorted index
+ * first, into a colourmap according to their target positions.
+ *
+ * Each colour is inserted at its target position, moving those
+ * already placed up a slot. Working backwards from the last insertion,
+ * a colour ends up in the pos'th slot not taken by a colour inserted
+ * after it.
+ */
 
-	epi_decrement (epi);
+static void
+palette_place (
+	const PALETTE	*pal,
+	int		first,
+	int		n,
+	const int	*pos,
+	RGB		*cols
+) {
+	int		i;
+	SLOT_SET	free_slots;
+
+	slot_set_fill (&free_slots, n);
+	for (i=0; i<n; i++) {
+	    int		slot = slot_set_select (&free_slots, pos[i]);
+
+	    slot_set_remove (&free_slots, slot);
+	    cols[slot] = pal->pal_rgb[pal->pal_order[first + i]];
+	}
 }
 
 
@@ -143,26 +550,20 @@ colourmap_max_storage (
 
 static BOOL
 colourmap_encode (
+	CONTEXT		*ctx,
 	GIFINFO		*gi,
 	EPI		*epi
 ) {
-	int		i, ncols = 0;
-	CMAP_INFO	ci_array[256];
-
-	ncols = unique_colours (gi->gi_colours, gi->gi_num_colours, ci_array);
+	int		i, ncols;
+	int		pos[256];
+	PALETTE		pal;
 
-	if (encrypting_colourmap ()) {
-	    for (i=0; i<ncols; i++) {
-		CMAP_INFO	*ci = &ci_array[i];
-
-		encrypt_colour (ci->rgb.r, ci->rgb.g, ci->rgb.b, ci->ctext);
-	    }
-	    qsort (ci_array, ncols, sizeof (CMAP_INFO), cmap_encrypt_cmp);
-	} else
-	    qsort (ci_array, ncols, sizeof (CMAP_INFO), cmap_cmp);
+	palette_load (ctx, gi, &pal);
+	palette_sort (ctx, &pal);
+	ncols = pal.pal_ncols;
 
 	for (i=0; i<ncols; i++)
-	    ci_array[ncols - i - 1].pos = epi_divide (epi, i + 1);
+	    pos[ncols - i - 1] = epi_divide (epi, i + 1);
 
 	if (epi->epi_high_bit > 0) {
 	    fprintf (stderr, "Error: remainder of %d bits.\n",
@@ -170,21 +571,113 @@ colourmap_encode (
 	    return (FALSE);
 	}
 
-	for (i=0; i<ncols; i++) {
-	    CMAP_INFO	*ci = &ci_array[ncols - i - 1];
-	    int		j, pos = ci->pos;
+	palette_place (&pal, 0, ncols, pos, gi->gi_colours);
+
+		/* Pad out the rest of the colourmap. */
+	i = ncols;
+	for (; i<gi->gi_num_colours; i++)
+	    gi->gi_colours[i] = gi->gi_colours[gi->gi_num_colours - 1];
+
+	return (TRUE);
+}
+
+
+/*
+ * Grouped permutation coding.
+ * The sorted palette is split into groups of GROUP_SIZE colours (the
+ * last group may be smaller), each small enough that its permutation
+ * number fits in 64 bits, since 20! < 2^64. Each group then stores the
+ * next floor (log2 (n!)) bits of the value as a plain integer, so no
+ * extended-precision arithmetic is needed, at the cost of some capacity.
+ */
+
+#define GROUP_SIZE	20
+
+
+/*
+ * Return the number of bits that can be stored in a colourmap with
+ * ncols unique colours using grouped coding.
+ */
+
+static int
+group_max_bits (
+	int		ncols
+) {
+	int		nbits = 0;
+
+	for (; ncols > 0; ncols -= GROUP_SIZE)
+	    nbits += fact_log2[ncols < GROUP_SIZE ? ncols : GROUP_SIZE];
+
+	return (nbits);
+}
+
 
-	    for (j=i; j>pos; j--)
-		gi->gi_colours[j] = gi->gi_colours[j - 1];
+/*
+ * Encode a colourmap with the specified value, using grouped coding.
+ * Each group's colours are shuffled amongst the group's own slots.
+ */
+
+static void
+colourmap_group_encode (
+	CONTEXT		*ctx,
+	GIFINFO		*gi,
+	const EPI	*epi
+) {
+	int		i, first, ncols, bit = 0;
+	PALETTE		pal;
+
+	palette_load (ctx, gi, &pal);
+	palette_sort (ctx, &pal);
+	ncols = pal.pal_ncols;
 
-	    gi->gi_colours[pos] = ci->rgb;
+	for (first = 0; first < ncols; first += GROUP_SIZE) {
+	    int		n = ncols - first;
+	    int		nbits, pos[GROUP_SIZE];
+	    uint64_t	v = 0;
+
+	    if (n > GROUP_SIZE)
+		n = GROUP_SIZE;
+
+	    nbits = fact_log2[n];
+	    for (i = nbits - 1; i >= 0; i--)
+		v = (v << 1) | epi->epi_bits[bit + i];
+	    bit += nbits;
+
+	    for (i=0; i<n; i++) {
+		pos[n - i - 1] = (int) (v % (i + 1));
+		v /= i + 1;
+	    }
+
+	    palette_place (&pal, first, n, pos, &gi->gi_colours[first]);
 	}
 
 		/* Pad out the rest of the colourmap. */
-	for (; i<gi->gi_num_colours; i++)
+	for (i = ncols; i<gi->gi_num_colours; i++)
 	    gi->gi_colours[i] = gi->gi_colours[gi->gi_num_colours - 1];
+}
 
-	return (TRUE);
+
+/*
+ * Create the encoding state of a context.
+ * Returns NULL if memory runs out.
+ */
+
+ENCODE_STATE *
+encode_state_create (void)
+{
+	return ((ENCODE_STATE *) calloc (1, sizeof (ENCODE_STATE)));
+}
+
+
+/*
+ * Destroy the encoding state of a context.
+ */
+
+void
+encode_state_destroy (
+	ENCODE_STATE	*en
+) {
+	free (en);
 }
 
 
@@ -193,10 +686,37 @@ colourmap_encode (
  */
 
 void
-encode_init (void)
-{
-	encode_bit_count = 0;
-	epi_init (&encode_bits);
+encode_init (
+	CONTEXT		*ctx
+) {
+	ctx->ctx_encode->en_bit_count = 0;
+}
+
+
+/*
+ * Encode a span of bits. They are stored until flushed, when the
+ * colourmap is reordered. Bits beyond the most any colourmap could
+ * store are only counted.
+ */
+
+BOOL
+encode_span (
+	CONTEXT		*ctx,
+	const uint64_t	*words,
+	int		nbits,
+	FILE		*inf,
+	FILE		*outf
+) {
+	ENCODE_STATE	*en = ctx->ctx_encode;
+	int		n = EPI_MAX_BITS - en->en_bit_count;
+
+	if (n > nbits)
+	    n = nbits;
+	if (n > 0)
+	    span_copy (en->en_words, en->en_bit_count, words, 0, n);
+	en->en_bit_count += nbits;
+
+	return (TRUE);
 }
 
 
@@ -206,15 +726,14 @@ encode_init (void)
 
 BOOL
 encode_bit (
+	CONTEXT		*ctx,
 	int		bit,
 	FILE		*inf,
 	FILE		*outf
 ) {
-	encode_bit_count++;
-	if (encode_bits.epi_high_bit < EPI_MAX_BITS)
-	    encode_bits.epi_bits[encode_bits.epi_high_bit++] = bit;
+	uint64_t	word = (uint64_t) bit << 63;
 
-	return (TRUE);
+	return (encode_span (ctx, &word, 1, inf, outf));
 }
 
 
@@ -224,92 +743,189 @@ encode_bit (
 
 BOOL
 encode_flush (
+	CONTEXT		*ctx,
 	FILE		*inf,
 	FILE		*outf
 ) {
+	ENCODE_STATE	*en = ctx->ctx_encode;
+	EPI		*bits = &en->en_bits;
 	GIFINFO		gi;
 	EPI		max_epi;
-	int		max_bits;
+	int		i, ncols, max_bits;
+	BOOL		fits;
+
+	epi_init (bits);
+	for (i=0; i<en->en_bit_count && i<EPI_MAX_BITS; i++)
+	    bits->epi_bits[i] = SPAN_BIT (en->en_words, i);
+	bits->epi_high_bit = i;
 
-	encode_bit_count++;
-	if (encode_bits.epi_high_bit < EPI_MAX_BITS)
-	    encode_bits.epi_bits[encode_bits.epi_high_bit++] = 1;
+	en->en_bit_count++;
+	if (bits->epi_high_bit < EPI_MAX_BITS)
+	    bits->epi_bits[bits->epi_high_bit++] = 1;
 
 	if (!gif_header_load (&gi, inf)) {
 	    fprintf (stderr, "Input file is not in GIF format.\n");
 	    return (FALSE);
 	}
 
-	colourmap_max_storage (&gi, &max_epi);
-	max_bits = max_epi.epi_high_bit;
+	ncols = unique_colour_count (ctx, &gi);
 
-	if (encode_bit_count > max_epi.epi_high_bit
-				|| epi_cmp (&encode_bits, &max_epi) > 0) {
+	if (ctx->ctx_group_flag) {
+	    max_bits = group_max_bits (ncols);
+	    fits = (en->en_bit_count <= max_bits);
+	} else {
+	    max_bits = colourmap_max_bits (ncols);
+	    fits = (en->en_bit_count < max_bits);
+
+		/* Only compare values if the bit lengths are the same */
+	    if (en->en_bit_count == max_bits) {
+		colourmap_max_storage (ncols, &max_epi);
+		fits = (epi_cmp (bits, &max_epi) <= 0);
+	    }
+	}
+
+	if (!fits) {
 	    if (max_bits == 0)
 		fprintf (stderr, "GIF file has no storage space.\n");
 	    else
 		fprintf (stderr,
 		"Message exceeded available space by approximately %.2f%%.\n",
-			((double) encode_bit_count / max_bits - 1.0) * 100.0);
+			((double) en->en_bit_count / max_bits - 1.0) * 100.0);
 
 	    return (FALSE);
 	}
 
-	if (!colourmap_encode (&gi, &encode_bits))
+	if (ctx->ctx_group_flag)
+	    colourmap_group_encode (ctx, &gi, bits);
+	else if (!colourmap_encode (ctx, &gi, bits))
 	    return (FALSE);
 
 	if (!gif_filter_save (&gi, inf, outf))
 	    return (FALSE);
 
-	if (!quiet_flag)
+	if (!ctx->ctx_quiet_flag)
 	    fprintf (stderr,
 		"Message used approximately %.2f%% of available space.\n",
-				(double) encode_bit_count / max_bits * 100.0);
+				(double) en->en_bit_count / max_bits * 100.0);
 
 	return (TRUE);
 }
 
 
 /*
- * Decode a value from a colourmap.
+ * Decode a value from a sorted palette.
  */
 
 static void
 colourmap_decode (
-	const GIFINFO	*gi,
+	const PALETTE	*pal,
 	EPI		*epi
 ) {
-	int		i, ncols = 0;
-	CMAP_INFO	ci_array[256];
-
-	ncols = unique_colours (gi->gi_colours, gi->gi_num_colours, ci_array);
-	for (i=0; i<ncols; i++)
-	    ci_array[i].pos = i;
-
-	if (encrypting_colourmap ()) {
-	    for (i=0; i<ncols; i++) {
-		CMAP_INFO	*ci = &ci_array[i];
-
-		encrypt_colour (ci->rgb.r, ci->rgb.g, ci->rgb.b, ci->ctext);
-	    }
-	    qsort (ci_array, ncols, sizeof (CMAP_INFO), cmap_encrypt_cmp);
-	} else
-	    qsort (ci_array, ncols, sizeof (CMAP_INFO), cmap_cmp);
+	int		i, ncols = pal->pal_ncols;
+	SLOT_SET	remaining;
 
 	epi_init (epi);
+	slot_set_fill (&remaining, ncols);
 
+		/* Each digit is the rank of a colour's position among
+		 * the positions of the colours that follow it.
+		 */
 	for (i = 0; i < ncols - 1; i++) {
-	    int		j, pos = ci_array[i].pos;
+	    int		pos = pal->pal_order[i];
 	    EPI		epi_pos;
 
 	    epi_multiply (epi, ncols - i);
-	    epi_set (&epi_pos, pos);
+	    epi_set (&epi_pos, slot_set_rank (&remaining, pos));
 	    epi_add (epi, &epi_pos);
 
-	    for (j = i + 1; j < ncols; j++)
-		if (ci_array[j].pos > pos)
-		    ci_array[j].pos--;
+	    slot_set_remove (&remaining, pos);
+	}
+}
+
+
+/*
+ * Decode the bottom 64 bits of the value in a sorted palette.
+ * Multiplication and addition modulo 2^64 give the same low bits
+ * as the arbitrary-precision versions.
+ */
+
+static uint64_t
+colourmap_decode_low (
+	const PALETTE	*pal
+) {
+	int		i, ncols = pal->pal_ncols;
+	uint64_t	v = 0;
+	SLOT_SET	remaining;
+
+	slot_set_fill (&remaining, ncols);
+
+	for (i = 0; i < ncols - 1; i++) {
+	    int		pos = pal->pal_order[i];
+
+	    v = v * (ncols - i) + slot_set_rank (&remaining, pos);
+	    slot_set_remove (&remaining, pos);
 	}
+
+	return (v);
+}
+
+
+/*
+ * Decode a value from a sorted palette, using grouped coding.
+ */
+
+static void
+colourmap_group_decode (
+	const PALETTE	*pal,
+	EPI		*epi
+) {
+	int		i, first, ncols = pal->pal_ncols, bit = 0;
+
+	epi_init (epi);
+
+	for (first = 0; first < ncols; first += GROUP_SIZE) {
+	    int		n = ncols - first, nbits;
+	    uint64_t	v = 0;
+	    SLOT_SET	remaining;
+
+	    if (n > GROUP_SIZE)
+		n = GROUP_SIZE;
+
+	    slot_set_fill (&remaining, 0);
+	    for (i=0; i<n; i++)
+		slot_set_add (&remaining, pal->pal_order[first + i]);
+
+	    for (i = 0; i < n - 1; i++) {
+		int	pos = pal->pal_order[first + i];
+
+		v = v * (n - i) + slot_set_rank (&remaining, pos);
+		slot_set_remove (&remaining, pos);
+	    }
+
+	    nbits = fact_log2[n];
+	    for (i=0; i<nbits; i++, bit++)
+		if ((epi->epi_bits[bit] = (v >> i) & 1) != 0)
+		    epi->epi_high_bit = bit + 1;
+	}
+}
+
+
+/*
+ * Pack the lowest nbits bits of a decoded value into a span.
+ */
+
+static void
+epi_span (
+	const EPI	*epi,
+	int		nbits,
+	uint64_t	*words
+) {
+	int		i;
+
+	memset (words, 0, SPAN_WORDS (nbits) * sizeof (uint64_t));
+	for (i=0; i<nbits; i++)
+	    if (epi->epi_bits[i])
+		words[i >> 6] |= (uint64_t) 1 << (63 - (i & 63));
 }
 
 
@@ -319,52 +935,291 @@ colourmap_decode (
 
 BOOL
 message_extract (
+	CONTEXT		*ctx,
 	FILE		*inf,
 	FILE		*outf
 ) {
 	GIFINFO		gi;
+	PALETTE		pal;
 	EPI		epi;
-	int		i;
+	uint64_t	words[SPAN_WORDS (EPI_MAX_BITS)];
+	int		nbits;
 
-	decrypt_init ();
+	decrypt_init (ctx);
 
 	if (!gif_header_load (&gi, inf)) {
 	    fprintf (stderr, "Input file is not in GIF format.\n");
 	    return (FALSE);
 	}
 
-	colourmap_decode (&gi, &epi);
+	palette_load (ctx, &gi, &pal);
+	palette_sort (ctx, &pal);
+
+	if (ctx->ctx_group_flag)
+	    colourmap_group_decode (&pal, &epi);
+	else
+	    colourmap_decode (&pal, &epi);
+
+	nbits = (epi.epi_high_bit > 0) ? epi.epi_high_bit - 1 : 0;
+	epi_span (&epi, nbits, words);
+
+	if (!decrypt_span (ctx, words, nbits, outf))
+	    return (FALSE);
+
+	return (decrypt_flush (ctx, outf));
+}
+
+
+/*
+ * A carrier whose unique colours have been loaded, so that it can be
+ * checked against any number of keys without being parsed again.
+ */
+
+struct carrier_struct {
+	PALETTE		c_pal;
+};
+
+
+/*
+ * Load a carrier from a GIF file.
+ * Returns NULL if the file isn't a GIF, or memory runs out.
+ */
+
+CARRIER *
+carrier_load (
+	const CONTEXT	*ctx,
+	FILE		*fp
+) {
+	GIFINFO		gi;
+	CARRIER		*c;
+
+	if (!gif_header_load (&gi, fp)) {
+	    fprintf (stderr, "Input file is not in GIF format.\n");
+	    return (NULL);
+	}
+
+	if ((c = (CARRIER *) malloc (sizeof (CARRIER))) == NULL) {
+	    fprintf (stderr, "Out of memory loading carrier.\n");
+	    return (NULL);
+	}
 
-	for (i = 0; i < epi.epi_high_bit - 1; i++)
-	    if (!decrypt_bit (epi.epi_bits[i], outf))
-		return (FALSE);
+	palette_load (ctx, &gi, &c->c_pal);
 
-	return (decrypt_flush (outf));
+	return (c);
 }
 
 
 /*
- * Calculate the amount of covert information that can be stored
- * in the file.
+ * Free a carrier.
  */
 
 void
-space_calculate (
-	FILE		*fp
+carrier_free (
+	CARRIER		*c
+) {
+	free (c);
+}
+
+
+/*
+ * Put a copy of a carrier's colours in the order given by a key.
+ */
+
+static void
+carrier_sort (
+	const CONTEXT	*ctx,
+	const CARRIER	*c,
+	PASSWORD_KEY	*pk,
+	PALETTE		*pal
+) {
+	memcpy (pal, &c->c_pal, sizeof (PALETTE));
+
+	if (ctx->ctx_v1_flag)
+	    palette_sort_natural (pal);
+	else {
+	    unsigned char	rgb[256 * 3], ctext[256 * 8];
+
+	    palette_rgb_bytes (pal, rgb);
+	    password_key_encrypt_colours (pk, pal->pal_ncols, rgb, ctext);
+	    palette_cipher_keys (pal, ctext);
+	    radix_sort (pal->pal_key, pal->pal_ncols, 8, pal->pal_order);
+	}
+}
+
+
+/*
+ * Decode the payload bits from the order of a sorted palette.
+ * Returns the number of bits.
+ */
+
+static int
+carrier_decode (
+	const CONTEXT	*ctx,
+	PALETTE		*pal,
+	uint64_t	*words
+) {
+	EPI		epi;
+	int		nbits;
+
+	if (ctx->ctx_group_flag)
+	    colourmap_group_decode (pal, &epi);
+	else
+	    colourmap_decode (pal, &epi);
+
+	nbits = (epi.epi_high_bit > 0) ? epi.epi_high_bit - 1 : 0;
+	epi_span (&epi, nbits, words);
+
+	return (nbits);
+}
+
+
+/*
+ * Check whether a key opens a carrier, by decoding the carrier's
+ * colour order under the key and checking the payload header.
+ * The context is only read, and otherwise just the key and local
+ * storage are used, so several threads can check keys at once.
+ * Returns the length of the message, or -1 if the key doesn't match.
+ */
+
+int
+carrier_key_check (
+	const CONTEXT	*ctx,
+	const CARRIER	*c,
+	PASSWORD_KEY	*pk
+) {
+	PALETTE		pal;
+	uint64_t	words[SPAN_WORDS (EPI_MAX_BITS)];
+	int		nbits;
+
+	carrier_sort (ctx, c, pk, &pal);
+
+		/* The header is in the lowest bits of the value, which
+		 * can be found cheaply modulo 2^64. A full decode, which
+		 * lets the length be checked too, is only needed if the
+		 * header's tag matches.
+		 */
+	if (!ctx->ctx_group_flag) {
+	    uint64_t	v = colourmap_decode_low (&pal), low = 0;
+	    int		i;
+
+	    for (i=0; i<64; i++)
+		low = (low << 1) | ((v >> i) & 1);
+
+	    if (!password_key_check_tag (ctx, pk, &low, 64))
+		return (-1);
+	}
+
+	nbits = carrier_decode (ctx, &pal, words);
+
+	return (password_key_check_header (ctx, pk, words, nbits));
+}
+
+
+/*
+ * Confirm that a key whose header check passed really opens a carrier,
+ * by decrypting the whole payload and checking that it uncompresses.
+ * A 12-bit header tag lets through about one wrong key in 4096.
+ * This uses the context's compression state, so only one thread may
+ * confirm keys with a context at a time.
+ * Returns FALSE if the key doesn't open the carrier.
+ */
+
+BOOL
+carrier_key_confirm (
+	CONTEXT		*ctx,
+	const CARRIER	*c,
+	PASSWORD_KEY	*pk
+) {
+	PALETTE		pal;
+	uint64_t	words[SPAN_WORDS (EPI_MAX_BITS)];
+	int		nbits;
+
+	carrier_sort (ctx, c, pk, &pal);
+	nbits = carrier_decode (ctx, &pal, words);
+
+	return (password_key_check_payload (ctx, pk, words, nbits));
+}
+
+
+/*
+ * Calculate the number of message bits that can be stored in a file,
+ * after any payload header or tags. If they are not NULL, total is
+ * given the number of bits the colourmap can store, and loss the number
+ * grouped coding loses against standard coding.
+ * Returns -1 if the file isn't a GIF.
+ */
+
+int
+message_capacity (
+	const CONTEXT	*ctx,
+	FILE		*fp,
+	int		*total,
+	int		*loss
 ) {
 	GIFINFO		gi;
-	EPI		max_epi;
-	int		max_bits;
+	int		ncols, max_bits, usable, avail;
 
 	if (!gif_header_load (&gi, fp)) {
 	    fprintf (stderr, "Input file is not in GIF format.\n");
-	    return;
+	    return (-1);
 	}
 
-	colourmap_max_storage (&gi, &max_epi);
-	max_bits = max_epi.epi_high_bit - 1;
-	if (max_bits < 0)
+	ncols = unique_colour_count (ctx, &gi);
+	max_bits = colourmap_max_bits (ncols) - 1;
+	if (max_bits < 0)		/* Fewer than 2 colours */
 	    max_bits = 0;
+
+	usable = max_bits;
+	if (ctx->ctx_group_flag) {
+	    usable = group_max_bits (ncols) - 1;
+	    if (usable < 0)
+		usable = 0;
+	}
+
+	if (total != NULL)
+	    *total = usable;
+
+	if (loss != NULL)
+	    *loss = max_bits - usable;
+
+		/* The payload header or method tag takes space from the message */
+	avail = usable;
+	if (ctx->ctx_header_flag)
+	    avail = (avail > HEADER_BITS) ? avail - HEADER_BITS : 0;
+	else if (ctx->ctx_compress_flag
+			&& ctx->ctx_compress_method != METHOD_HUFFMAN)
+	    avail = (avail > HEADER_METHOD_BITS)
+					? avail - HEADER_METHOD_BITS : 0;
+	if (ctx->ctx_compress_flag && ctx->ctx_compress_method == METHOD_DICT) {
+	    int		nid = dict_id_bits (ctx->ctx_compress_dict);
+
+	    avail = (avail > nid) ? avail - nid : 0;
+	}
+
+	return (avail);
+}
+
+
+/*
+ * Calculate the amount of covert information that can be stored
+ * in the file.
+ */
+
+void
+space_calculate (
+	const CONTEXT	*ctx,
+	FILE		*fp
+) {
+	int		avail, total, loss;
+
+	if ((avail = message_capacity (ctx, fp, &total, &loss)) < 0)
+	    return;
+
 	printf ("File has storage capacity of %d bits (%d bytes)\n",
-						max_bits, max_bits / 8);
+						avail, avail / 8);
+
+	if (loss > 0 && !ctx->ctx_quiet_flag)
+	    printf ("Grouped coding loses %d bits (%.2f%%) %s\n", loss,
+			(double) loss / (total + loss) * 100.0,
+			"against standard coding");
 }
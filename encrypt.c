@@ -1,54 +1,188 @@
 /*
  * Encryption routines for the gifshuffle steganography program.
- * Uses the ICE encryption algorithm in 1-bit cipher-feedback (CFB) mode.
+ * Uses the ICE encryption algorithm in 1-bit cipher-feedback (CFB) mode,
+ * or optionally 64-bit CFB mode.
  *
  * Written by Matthew Kwan - December 1996
  */
 
 #include "gifshuf.h"
 #include "ice.h"
+#include "epi.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+#if defined (unix) || defined (__unix__)
+#include <pthread.h>
+#define KEY_LOCKING
+#endif
+
 
 /*
- * The key to use for encryption/decryption.
+ * A key built from a password, with its initialization vector.
+ * Keys are reference counted, since they can be shared between the
+ * key cache, contexts, and callers holding handles, in any thread.
+ * Every key built gets a new serial number, which is never reused by
+ * the process, so results cached under it can only belong to the key.
  */
 
-static ICE_KEY		*ice_key = NULL;
-static unsigned char	encrypt_iv_block[8];
+struct password_key_struct {
+	ICE_KEY		*pk_ice;
+	uint64_t	pk_serial;
+	uint64_t	pk_hash;		/* Hash of the key bytes */
+	int		pk_level;
+	BOOL		pk_fixed;
+	int		pk_refs;
+	unsigned long	pk_last_used;
+	unsigned char	pk_iv[8];
+	unsigned char	pk_key[1024];		/* The password's key bytes */
+};
 
 
 /*
- * Build the ICE key from the supplied password.
+ * The stages that encrypted spans are passed through, chosen when the
+ * encryption routines are initialized. Spans go to the encrypt stage,
+ * which holds them back if a payload header is being used, and then
+ * to the payload stage, which encrypts them if there is a key.
+ */
+
+typedef BOOL	(*SPAN_STAGE) (CONTEXT *ctx, const uint64_t *words,
+					int nbits, FILE *inf, FILE *outf);
+
+
+/*
+ * Spans are encrypted in chunks of at most this many words.
+ */
+
+#define ENCRYPT_CHUNK_WORDS	32
+
+
+/*
+ * The longest message a payload header can describe.
+ */
+
+#define HEADER_MAX_LENGTH	((1 << HEADER_LENGTH_BITS) - 1)
+
+
+/*
+ * Least-recently-used cache of built keys, shared by the whole process,
+ * so that contexts using the same password, such as one-shot library
+ * calls, or files processed in turn, don't rebuild its key schedule.
+ */
+
+#define KEY_CACHE_SIZE		16
+
+
+/*
+ * Cache of encrypted colours.
+ * Carriers tend to share a few standard palettes, so when several files
+ * are processed with the same key most colours have been encrypted
+ * before. Entries are tagged with the serial number of the key used,
+ * which no other key shares, and hold the colour they encrypt.
+ */
+
+#define COLOUR_CACHE_SIZE	1024
+
+typedef struct {
+	BOOL		cc_valid;
+	uint64_t	cc_serial;
+	unsigned long	cc_rgb;
+	unsigned char	cc_ctext[8];
+} COLOUR_CACHE_ENTRY;
+
+
+/*
+ * The encryption state of a context.
+ * In 64-bit CFB mode one ICE block is encrypted for every 64 bits of
+ * the shift register, with the ciphertext being collected to form the
+ * next register. Message bits are held back while a payload header is
+ * being used, and ciphertext bits passed in one at a time are held
+ * until the decryption routines are flushed.
+ */
+
+struct encrypt_state_struct {
+	PASSWORD_KEY	*es_current_key;
+	ICE_KEY		*es_ice_key;
+	uint64_t	es_key_serial;
+
+	uint64_t	es_register;
+	uint64_t	es_keystream;
+	uint64_t	es_feedback;
+	int		es_segment_bits;
+
+	SPAN_STAGE	es_encrypt_stage;
+	SPAN_STAGE	es_payload_stage;
+
+	uint64_t	es_header_words[SPAN_WORDS (HEADER_MAX_LENGTH)];
+	int		es_header_bit_count;
+
+	uint64_t	es_pending[SPAN_WORDS (EPI_MAX_BITS)];
+	int		es_pending_bits;
+
+	COLOUR_CACHE_ENTRY	es_colour_cache[COLOUR_CACHE_SIZE];
+};
+
+
+/*
+ * Local variables.
+ */
+
+static PASSWORD_KEY	*key_cache[KEY_CACHE_SIZE];
+static unsigned long	key_cache_clock = 0;
+static uint64_t		key_serial = 0;
+
+#ifdef KEY_LOCKING
+static pthread_mutex_t	key_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+/*
+ * Calculate a 64-bit FNV-1a hash of a buffer.
+ */
+
+static uint64_t
+fnv_hash (
+	const unsigned char	*buf,
+	int			len,
+	uint64_t		h
+) {
+	int			i;
+
+	for (i=0; i<len; i++) {
+	    h ^= buf[i];
+	    h *= 0x100000001b3ULL;
+	}
+
+	return (h);
+}
+
+
+/*
+ * Convert a password into ICE key bytes and return the key level.
  * Only uses the lower 7 bits from each character.
  */
 
-void
-password_set (
-	const char	*passwd
+static int
+password_key_bytes (
+	const CONTEXT	*ctx,
+	const char	*passwd,
+	unsigned char	*buf
 ) {
 	int		i, level;
-	unsigned char	buf[1024];
 
 	level = (strlen (passwd) * 7 + 63) / 64;
 
 	if (level == 0) {
-	    if (!quiet_flag)
+	    if (!ctx->ctx_quiet_flag)
 		fprintf (stderr, "Warning: an empty password is being used\n");
 	    level = 1;
 	} else if (level > 128) {
-	    if (!quiet_flag)
+	    if (!ctx->ctx_quiet_flag)
 		fprintf (stderr, "Warning: password truncated to 1170 chars\n");
 	    level = 128;
 	}
 
-	if ((ice_key = ice_key_create (level)) == NULL) {
-	    if (!quiet_flag)
-		fprintf (stderr, "Warning: failed to set password\n");
-	    return;
-	}
-
 	for (i=0; i<1024; i++)
 	    buf[i] = 0;
 
@@ -74,12 +208,373 @@ password_set (
 		break;
 	}
 
-	ice_key_set (ice_key, buf);
+	return (level);
+}
+
+
+/*
+ * Derive a fixed-size key from the full key bytes, in the manner of
+ * PBKDF2, with ICE under the full key as the pseudo-random function.
+ * Each 8-byte block of the smaller key is the exclusive-or of a chain
+ * of KDF_ITERATIONS encryptions, which starts from the salt with the
+ * block number, and in which every input is mixed with a constant
+ * that no other use of the key encrypts.
+ * The payload has no room for a random salt, so the salt is a fixed
+ * constant, which only stops tables built for other programs' keys
+ * being used. The cost is one key schedule at the password's level,
+ * plus FIXED_KEY_LEVEL * KDF_ITERATIONS encryptions at that level,
+ * which is about 2ms for a short password and 40ms for one of 200
+ * characters on a current PC. Keys are cached, so this is paid once
+ * for each password.
+ */
+
+#define FIXED_KEY_LEVEL		2
+#define KDF_ITERATIONS		8192
+
+static const unsigned char	kdf_salt[8] = {
+	'g', 'i', 'f', 's', 'h', 'u', 'f', 'K'
+};
+static const unsigned char	kdf_domain[8] = {
+	0x4b, 0x44, 0x46, 0x2d, 0x49, 0x43, 0x45, 0x31
+};
+
+static BOOL
+fixed_key_derive (
+	const unsigned char	*buf,
+	int			level,
+	unsigned char		*dbuf
+) {
+	ICE_KEY			*ik;
+	unsigned char		u[8], t[8];
+	int			i, j, k;
+
+	if ((ik = ice_key_create (level)) == NULL)
+	    return (FALSE);
+
+	ice_key_set (ik, buf);
+
+	memset (dbuf, 0, 1024);
+	for (i=0; i<FIXED_KEY_LEVEL; i++) {
+	    memcpy (u, kdf_salt, 8);
+	    u[6] ^= level;
+	    u[7] ^= i + 1;
+	    memset (t, 0, 8);
+
+	    for (j=0; j<KDF_ITERATIONS; j++) {
+		for (k=0; k<8; k++)
+		    u[k] ^= kdf_domain[k];
+		ice_key_encrypt (ik, u, u);
+		for (k=0; k<8; k++)
+		    t[k] ^= u[k];
+	    }
+
+	    memcpy (&dbuf[i * 8], t, 8);
+	}
+
+	memset (u, 0, 8);
+	memset (t, 0, 8);
+	ice_key_destroy (ik);
+
+	return (TRUE);
+}
+
+
+/*
+ * Lock the key cache and the reference counts of the keys.
+ */
+
+static void
+key_lock (void)
+{
+#ifdef KEY_LOCKING
+	pthread_mutex_lock (&key_mutex);
+#endif
+}
+
+
+/*
+ * Unlock the key cache and the reference counts of the keys.
+ */
+
+static void
+key_unlock (void)
+{
+#ifdef KEY_LOCKING
+	pthread_mutex_unlock (&key_mutex);
+#endif
+}
+
+
+/*
+ * Destroy a key with no references left.
+ */
+
+static void
+password_key_destroy (
+	PASSWORD_KEY	*pk
+) {
+	ice_key_destroy (pk->pk_ice);
+	memset (pk, 0, sizeof (PASSWORD_KEY));
+	free (pk);
+}
+
+
+/*
+ * Release a reference to a key, destroying it if it was the last one.
+ */
+
+void
+password_key_release (
+	PASSWORD_KEY	*pk
+) {
+	BOOL		last;
+
+	if (pk == NULL)
+	    return;
+
+	key_lock ();
+	last = (--pk->pk_refs == 0);
+	key_unlock ();
+
+	if (last)
+	    password_key_destroy (pk);
+}
+
+
+/*
+ * Look for a key in the key cache, and take a reference to it.
+ * The hash only finds the candidates, which must have the same key
+ * bytes. The cache must be locked.
+ */
+
+static PASSWORD_KEY *
+key_cache_find (
+	uint64_t		hash,
+	int			level,
+	BOOL			fixed,
+	const unsigned char	*buf
+) {
+	int			i;
+
+	for (i=0; i<KEY_CACHE_SIZE; i++) {
+	    PASSWORD_KEY	*pk = key_cache[i];
+
+	    if (pk != NULL && pk->pk_hash == hash && pk->pk_level == level
+				&& pk->pk_fixed == fixed
+				&& memcmp (pk->pk_key, buf, level * 8) == 0) {
+		pk->pk_last_used = ++key_cache_clock;
+		pk->pk_refs++;
+		return (pk);
+	    }
+	}
+
+	return (NULL);
+}
+
+
+/*
+ * Add a newly built key to the key cache, replacing the least recently
+ * used key if the cache is full, and give it a serial number. If
+ * another thread has added the same key meanwhile, the new key is
+ * destroyed and the other returned instead.
+ */
+
+static PASSWORD_KEY *
+key_cache_add (
+	PASSWORD_KEY	*pk
+) {
+	PASSWORD_KEY	*found, *victim = NULL;
+	int		i, v = 0;
+
+	key_lock ();
+
+	if ((found = key_cache_find (pk->pk_hash, pk->pk_level,
+					pk->pk_fixed, pk->pk_key)) != NULL) {
+	    key_unlock ();
+	    password_key_destroy (pk);
+	    return (found);
+	}
+
+	for (i=0; i<KEY_CACHE_SIZE; i++) {
+	    if (key_cache[i] == NULL) {
+		v = i;
+		break;
+	    }
+	    if (key_cache[i]->pk_last_used < key_cache[v]->pk_last_used)
+		v = i;
+	}
+
+	if ((victim = key_cache[v]) != NULL && --victim->pk_refs > 0)
+	    victim = NULL;
+
+	pk->pk_serial = ++key_serial;
+	pk->pk_last_used = ++key_cache_clock;
+	pk->pk_refs = 2;		/* The cache and the caller */
+	key_cache[v] = pk;
+
+	key_unlock ();
+
+	if (victim != NULL)
+	    password_key_destroy (victim);
+
+	return (pk);
+}
+
+
+/*
+ * Create the encryption state of a context, with no key.
+ * Returns NULL if memory runs out.
+ */
+
+ENCRYPT_STATE *
+encrypt_state_create (void)
+{
+	return ((ENCRYPT_STATE *) calloc (1, sizeof (ENCRYPT_STATE)));
+}
+
+
+/*
+ * Destroy the encryption state of a context, releasing its key.
+ */
+
+void
+encrypt_state_destroy (
+	ENCRYPT_STATE	*es
+) {
+	if (es == NULL)
+	    return;
+
+	password_key_release (es->es_current_key);
+
+	memset (es, 0, sizeof (ENCRYPT_STATE));
+	free (es);
+}
+
+
+/*
+ * Return a handle to the key for the supplied password.
+ * Keys are looked up in the key cache by a hash of their key bytes,
+ * and confirmed by comparing the bytes, and built and added to the
+ * cache if not found. The key's serial number tags the entries it adds
+ * to the colour and palette order caches.
+ * If the fixed key option is set, a fixed-size key is derived from the
+ * password, so that the cost of encryption doesn't depend on the
+ * length of the password.
+ * The caller must release the handle when finished with it.
+ */
+
+PASSWORD_KEY *
+password_key_get (
+	const CONTEXT	*ctx,
+	const char	*passwd
+) {
+	BOOL		fixed = ctx->ctx_fixed_key_flag;
+	int		level;
+	uint64_t	hash;
+	unsigned char	buf[1024], dbuf[1024];
+	PASSWORD_KEY	*pk;
+
+	level = password_key_bytes (ctx, passwd, buf);
+	hash = fnv_hash (buf, level * 8, 0xcbf29ce484222325ULL ^ level
+					^ (fixed ? 0x100 : 0));
+
+	key_lock ();
+	pk = key_cache_find (hash, level, fixed, buf);
+	key_unlock ();
+
+	if (pk != NULL) {
+	    memset (buf, 0, sizeof (buf));
+	    return (pk);
+	}
+
+	if ((pk = (PASSWORD_KEY *) malloc (sizeof (PASSWORD_KEY))) == NULL)
+	    return (NULL);
+
+	pk->pk_hash = hash;
+	pk->pk_level = level;
+	pk->pk_fixed = fixed;
+	memcpy (pk->pk_key, buf, sizeof (pk->pk_key));
+
+	if (fixed) {
+	    if (!fixed_key_derive (buf, level, dbuf)) {
+		memset (buf, 0, sizeof (buf));
+		memset (pk, 0, sizeof (PASSWORD_KEY));
+		free (pk);
+		return (NULL);
+	    }
+	    memcpy (buf, dbuf, sizeof (buf));
+	    memset (dbuf, 0, sizeof (dbuf));
+	    level = FIXED_KEY_LEVEL;
+	}
+
+	if ((pk->pk_ice = ice_key_create (level)) == NULL) {
+	    memset (buf, 0, sizeof (buf));
+	    memset (pk, 0, sizeof (PASSWORD_KEY));
+	    free (pk);
+	    return (NULL);
+	}
+
+	ice_key_set (pk->pk_ice, buf);
 
 		/* Set the initialization vector with the key
 		 * with itself.
 		 */
-	ice_key_encrypt (ice_key, buf, encrypt_iv_block);
+	ice_key_encrypt (pk->pk_ice, buf, pk->pk_iv);
+	memset (buf, 0, sizeof (buf));
+
+	return (key_cache_add (pk));
+}
+
+
+/*
+ * Make a key the current key for encryption and decryption.
+ * A NULL key turns encryption off.
+ */
+
+void
+password_key_use (
+	CONTEXT		*ctx,
+	PASSWORD_KEY	*pk
+) {
+	ENCRYPT_STATE	*es = ctx->ctx_encrypt;
+
+	if (pk != NULL) {
+	    key_lock ();
+	    pk->pk_refs++;
+	    key_unlock ();
+	}
+	password_key_release (es->es_current_key);
+
+	if ((es->es_current_key = pk) == NULL) {
+	    es->es_ice_key = NULL;
+	    es->es_key_serial = 0;
+	    return;
+	}
+
+	es->es_ice_key = pk->pk_ice;
+	es->es_key_serial = pk->pk_serial;
+}
+
+
+/*
+ * Build the ICE key from the supplied password.
+ */
+
+void
+password_set (
+	CONTEXT		*ctx,
+	const char	*passwd
+) {
+	PASSWORD_KEY	*pk;
+
+	if ((pk = password_key_get (ctx, passwd)) == NULL) {
+	    if (!ctx->ctx_quiet_flag)
+		fprintf (stderr, "Warning: failed to set password\n");
+	    return;
+	}
+
+	password_key_use (ctx, pk);
+	password_key_release (pk);
 }
 
 
@@ -88,9 +583,126 @@ password_set (
  */
 
 BOOL
-encrypting_colourmap (void)
-{
-	return (!v1_flag && ice_key != NULL);
+encrypting_colourmap (
+	CONTEXT		*ctx
+) {
+	return (!ctx->ctx_v1_flag && ctx->ctx_encrypt->es_ice_key != NULL);
+}
+
+
+/*
+ * Return the serial number of the current key, or zero if there is
+ * none. Two keys never share a serial number.
+ */
+
+uint64_t
+encrypt_key_id (
+	CONTEXT		*ctx
+) {
+	return (ctx->ctx_encrypt->es_key_serial);
+}
+
+
+/*
+ * Encrypt a number of colours, given as 3-byte RGB triples, with the
+ * given key, bypassing the colour cache so that it is safe to call
+ * from several threads at once.
+ */
+
+void
+password_key_encrypt_colours (
+	PASSWORD_KEY		*pk,
+	int			n,
+	const unsigned char	*rgb,
+	unsigned char		*ctext
+) {
+	unsigned char		ptext[256 * 8];
+	int			i, m;
+
+	for (; n > 0; n -= m, rgb += m * 3, ctext += m * 8) {
+	    m = (n < 256) ? n : 256;
+
+	    memset (ptext, 0, m * 8);
+	    for (i=0; i<m; i++)
+		memcpy (&ptext[i * 8], &rgb[i * 3], 3);
+
+	    ice_key_encrypt_many (pk->pk_ice, ptext, ctext, m);
+	}
+}
+
+
+/*
+ * Encrypt a number of colours, given as 3-byte RGB triples, giving
+ * 8 bytes of ciphertext for each.
+ * Results are looked up in, and added to, the colour cache, and the
+ * colours not found are encrypted together as one batch.
+ */
+
+void
+encrypt_colours (
+	CONTEXT			*ctx,
+	int			n,
+	const unsigned char	*rgb,
+	unsigned char		*ctext
+) {
+	ENCRYPT_STATE		*es = ctx->ctx_encrypt;
+	COLOUR_CACHE_ENTRY	*colour_cache = es->es_colour_cache;
+	uint64_t		serial = es->es_key_serial;
+	unsigned char		ptext[256 * 8], mtext[256 * 8];
+	int			miss[256];
+	int			i, nmiss = 0;
+
+	if (es->es_ice_key == NULL)
+	    return;
+
+	while (n > 256) {
+	    encrypt_colours (ctx, 256, rgb, ctext);
+	    n -= 256;
+	    rgb += 256 * 3;
+	    ctext += 256 * 8;
+	}
+
+	for (i=0; i<n; i++) {
+	    const unsigned char	*c = &rgb[i * 3];
+	    unsigned long	v = ((unsigned long) c[0] << 16)
+							| (c[1] << 8) | c[2];
+	    COLOUR_CACHE_ENTRY	*cc;
+
+	    cc = &colour_cache[(((uint64_t) v * 0x9e3779b97f4a7c15ULL
+				^ serial) >> 20) % COLOUR_CACHE_SIZE];
+
+	    if (cc->cc_valid && cc->cc_rgb == v
+					&& cc->cc_serial == serial) {
+		memcpy (&ctext[i * 8], cc->cc_ctext, 8);
+		continue;
+	    }
+
+	    memcpy (&ptext[nmiss * 8], c, 3);
+	    memset (&ptext[nmiss * 8 + 3], 0, 5);
+	    miss[nmiss++] = i;
+	}
+
+	if (nmiss == 0)
+	    return;
+
+	ice_key_encrypt_many (es->es_ice_key, ptext, mtext, nmiss);
+
+	for (i=0; i<nmiss; i++) {
+	    const unsigned char	*c = &ptext[i * 8];
+	    unsigned long	v = ((unsigned long) c[0] << 16)
+							| (c[1] << 8) | c[2];
+	    COLOUR_CACHE_ENTRY	*cc;
+
+	    cc = &colour_cache[(((uint64_t) v * 0x9e3779b97f4a7c15ULL
+				^ serial) >> 20) % COLOUR_CACHE_SIZE];
+
+	    cc->cc_valid = TRUE;
+	    cc->cc_serial = serial;
+	    cc->cc_rgb = v;
+	    memcpy (cc->cc_ctext, &mtext[i * 8], 8);
+
+	    memcpy (&ctext[miss[i] * 8], &mtext[i * 8], 8);
+	}
 }
 
 
@@ -100,68 +712,275 @@ encrypting_colourmap (void)
 
 void
 encrypt_colour (
+	CONTEXT		*ctx,
 	unsigned char	r,
 	unsigned char	g,
 	unsigned char	b,
 	unsigned char	*ctext
 ) {
-	unsigned char	ptext[8];
+	unsigned char	rgb[3];
+
+	rgb[0] = r;
+	rgb[1] = g;
+	rgb[2] = b;
+
+	encrypt_colours (ctx, 1, rgb, ctext);
+}
+
+
+/*
+ * Calculate the check tag of a payload header.
+ * With a password the tag comes from encrypting the header fields,
+ * so a wrong key can be rejected as soon as the header is decrypted.
+ * Without one it is just a hash of them.
+ */
+
+static int
+header_tag (
+	const ICE_KEY	*ik,
+	int		length,
+	int		method
+) {
+	unsigned char	block[8], ctext[8];
+
+	block[0] = 'G';
+	block[1] = 'S';
+	block[2] = 'H';
+	block[3] = 1;
+	block[4] = (length >> 8) & 0xff;
+	block[5] = length & 0xff;
+	block[6] = method;
+	block[7] = 0;
+
+	if (ik == NULL)
+	    return ((int) (fnv_hash (block, 8, 0xcbf29ce484222325ULL) >> 52));
+
+	ice_key_encrypt (ik, block, ctext);
+
+	return ((ctext[0] << 4) | (ctext[1] >> 4));
+}
+
+
+/*
+ * Convert an 8-byte block to a 64-bit word, first byte uppermost.
+ */
+
+static uint64_t
+block_word (
+	const unsigned char	*block
+) {
+	uint64_t		w = 0;
+	int			i;
+
+	for (i=0; i<8; i++)
+	    w = (w << 8) | block[i];
+
+	return (w);
+}
+
+
+/*
+ * Convert a 64-bit word to an 8-byte block, uppermost byte first.
+ */
+
+static void
+word_block (
+	uint64_t	w,
+	unsigned char	*block
+) {
 	int		i;
 
-	if (ice_key == NULL)
-	    return;
+	for (i=7; i>=0; i--) {
+	    block[i] = w & 0xff;
+	    w >>= 8;
+	}
+}
+
+
+/*
+ * Encrypt the bits of a span in CFB mode, and pass them on to be
+ * encoded. Each piece of up to 64 bits lies within one segment of the
+ * register, so in 64-bit mode it is XORed with the keystream at once,
+ * while in 1-bit mode the register is encrypted for every bit.
+ */
+
+static BOOL
+cfb_encrypt_span (
+	CONTEXT		*ctx,
+	const uint64_t	*words,
+	int		nbits,
+	FILE		*inf,
+	FILE		*outf
+) {
+	ENCRYPT_STATE	*es = ctx->ctx_encrypt;
+	uint64_t	out[ENCRYPT_CHUNK_WORDS];
+	unsigned char	block[8], ks[8];
+	int		pos, i, j, k, n;
 
-	ptext[0] = r;
-	ptext[1] = g;
-	ptext[2] = b;
+	for (pos = 0; pos < nbits; pos += n) {
+	    n = nbits - pos;
+	    if (n > ENCRYPT_CHUNK_WORDS * 64)
+		n = ENCRYPT_CHUNK_WORDS * 64;
 
-	for (i=3; i<8; i++)
-	    ptext[i] = 0;
+	    for (i=0; i<n; i += k) {
+		uint64_t	p, c = 0;
 
-	ice_key_encrypt (ice_key, ptext, ctext);
+		k = 64 - es->es_segment_bits;
+		if (k > n - i)
+		    k = n - i;
+		p = span_read (words, pos + i, k);
+
+		if (!ctx->ctx_block_flag) {
+		    for (j = k - 1; j >= 0; j--) {
+			int	bit = (p >> j) & 1;
+
+			word_block (es->es_register, block);
+			ice_key_encrypt (es->es_ice_key, block, ks);
+			bit ^= ks[0] >> 7;
+
+			es->es_register = (es->es_register << 1) | bit;
+			c = (c << 1) | bit;
+		    }
+
+		    span_write (out, i, c, k);
+		    continue;
+		}
+
+		if (es->es_segment_bits == 0) {
+		    word_block (es->es_register, block);
+		    ice_key_encrypt (es->es_ice_key, block, ks);
+		    es->es_keystream = block_word (ks);
+		    es->es_feedback = 0;
+		}
+
+		c = p ^ ((es->es_keystream << es->es_segment_bits)
+								>> (64 - k));
+
+			/* Feed back the ciphertext */
+		es->es_feedback |= c << (64 - es->es_segment_bits - k);
+		if ((es->es_segment_bits += k) == 64) {
+		    es->es_register = es->es_feedback;
+		    es->es_segment_bits = 0;
+		}
+
+		span_write (out, i, c, k);
+	    }
+
+	    if (!encode_span (ctx, out, n, inf, outf))
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+
+/*
+ * Hold back the bits of a span until the length of the message is
+ * known, for the payload header.
+ */
+
+static BOOL
+header_hold_span (
+	CONTEXT		*ctx,
+	const uint64_t	*words,
+	int		nbits,
+	FILE		*inf,
+	FILE		*outf
+) {
+	ENCRYPT_STATE	*es = ctx->ctx_encrypt;
+	int		n = HEADER_MAX_LENGTH - es->es_header_bit_count;
+
+	if (n > nbits)
+	    n = nbits;
+	if (n > 0)
+	    span_copy (es->es_header_words, es->es_header_bit_count,
+								words, 0, n);
+	es->es_header_bit_count += nbits;
+
+	return (TRUE);
 }
 
 
 /*
- * Initialize the encryption routines.
+ * Initialize the encryption routines, and choose the stages that
+ * spans are passed through.
  */
 
 void
-encrypt_init (void)
-{
-	encode_init ();
+encrypt_init (
+	CONTEXT		*ctx
+) {
+	ENCRYPT_STATE	*es = ctx->ctx_encrypt;
+
+	if (es->es_current_key != NULL)
+	    es->es_register = block_word (es->es_current_key->pk_iv);
+	es->es_keystream = 0;
+	es->es_feedback = 0;
+	es->es_segment_bits = 0;
+	es->es_header_bit_count = 0;
+
+	es->es_payload_stage = (es->es_ice_key != NULL)
+					? cfb_encrypt_span : encode_span;
+	es->es_encrypt_stage = ctx->ctx_header_flag
+				? header_hold_span : es->es_payload_stage;
+
+	encode_init (ctx);
 }
 
 
 /*
- * Encrypt a single bit.
+ * Encrypt a span of bits, most significant first.
+ * If a payload header is being used, the bits are held back until
+ * the length of the message is known.
  */
 
 BOOL
-encrypt_bit (
-	int		bit,
+encrypt_span (
+	CONTEXT		*ctx,
+	const uint64_t	*words,
+	int		nbits,
 	FILE		*inf,
 	FILE		*outf
 ) {
-	int		i;
-	unsigned char	buf[8];
+	return (ctx->ctx_encrypt->es_encrypt_stage (ctx, words, nbits,
+								inf, outf));
+}
 
-	if (ice_key == NULL)
-	    return (encode_bit (bit, inf, outf));
 
-	ice_key_encrypt (ice_key, encrypt_iv_block, buf);
-	if ((buf[0] & 128) != 0)
-	    bit = !bit;
+/*
+ * Encrypt the bottom nbits bits of a word, most significant first.
+ */
 
-			/* Rotate the IV block one bit left */
-	for (i=0; i<8; i++) {
-	    encrypt_iv_block[i] <<= 1;
-	    if (i < 7 && (encrypt_iv_block[i+1] & 128) != 0)
-		encrypt_iv_block[i] |= 1;
-	}
-	encrypt_iv_block[7] |= bit;
+BOOL
+encrypt_word (
+	CONTEXT		*ctx,
+	uint64_t	word,
+	int		nbits,
+	FILE		*inf,
+	FILE		*outf
+) {
+	if (nbits == 0)
+	    return (TRUE);
 
-	return (encode_bit (bit, inf, outf));
+	word <<= 64 - nbits;
+
+	return (ctx->ctx_encrypt->es_encrypt_stage (ctx, &word, nbits,
+								inf, outf));
+}
+
+
+/*
+ * Encrypt a single bit.
+ */
+
+BOOL
+encrypt_bit (
+	CONTEXT		*ctx,
+	int		bit,
+	FILE		*inf,
+	FILE		*outf
+) {
+	return (encrypt_word (ctx, bit, 1, inf, outf));
 }
 
 
@@ -171,10 +990,36 @@ encrypt_bit (
 
 BOOL
 encrypt_flush (
+	CONTEXT		*ctx,
 	FILE		*inf,
 	FILE		*outf
 ) {
-	return (encode_flush (inf, outf));
+	ENCRYPT_STATE	*es = ctx->ctx_encrypt;
+	int		nbits = es->es_header_bit_count;
+	uint64_t	fields;
+	int		method, tag;
+
+	if (!ctx->ctx_header_flag)
+	    return (encode_flush (ctx, inf, outf));
+
+	if (nbits > HEADER_MAX_LENGTH) {
+	    fprintf (stderr, "Message is too long for the payload header.\n");
+	    return (FALSE);
+	}
+
+	method = compress_method_id (ctx);
+	tag = header_tag (es->es_ice_key, nbits, method);
+
+	fields = ((uint64_t) nbits << (HEADER_METHOD_BITS + HEADER_TAG_BITS))
+			| (method << HEADER_TAG_BITS) | tag;
+	fields <<= 64 - HEADER_BITS;
+
+	if (!es->es_payload_stage (ctx, &fields, HEADER_BITS, inf, outf)
+		|| !es->es_payload_stage (ctx, es->es_header_words, nbits,
+								inf, outf))
+	    return (FALSE);
+
+	return (encode_flush (ctx, inf, outf));
 }
 
 
@@ -183,43 +1028,328 @@ encrypt_flush (
  */
 
 void
-decrypt_init (void)
-{
-	uncompress_init ();
+decrypt_init (
+	CONTEXT		*ctx
+) {
+	ctx->ctx_encrypt->es_pending_bits = 0;
+
+	uncompress_init (ctx);
+}
+
+
+/*
+ * Decrypt the bits of a span from bit first up to nbits, all of whose
+ * ciphertext is known, with the given key and initialization vector.
+ * The plaintext of any bits before first is left as it is, so a span
+ * can be decrypted a piece at a time.
+ * In CFB mode the keystream for each bit, or each 64-bit segment,
+ * depends only on the ciphertext before it, so all the shift register
+ * states can be built first and encrypted in batches. No shared state
+ * is touched, so spans can be decrypted in parallel.
+ */
+
+#define DECRYPT_BATCH		256
+
+static void
+span_decrypt (
+	BOOL			block,
+	const ICE_KEY		*ik,
+	const unsigned char	*iv,
+	const uint64_t		*words,
+	int			first,
+	int			nbits,
+	uint64_t		*plain
+) {
+	unsigned char		reg[DECRYPT_BATCH * 8], ks[DECRYPT_BATCH * 8];
+	uint64_t		reg0 = block_word (iv);
+	int			i, j, n;
+
+	if (nbits <= first)
+	    return;
+
+	if (block) {
+	    int		nseg = SPAN_WORDS (nbits);
+
+		/* The segment holding bit first is decrypted whole */
+	    for (i = first >> 6; i<nseg; i += n) {
+		n = (nseg - i < DECRYPT_BATCH) ? nseg - i : DECRYPT_BATCH;
+
+			/* Each segment's register is the previous ciphertext */
+		for (j=0; j<n; j++)
+		    word_block ((i + j == 0) ? reg0 : words[i + j - 1],
+								&reg[j * 8]);
+
+		ice_key_encrypt_many (ik, reg, ks, n);
+
+		for (j=0; j<n; j++)
+		    plain[i + j] = words[i + j] ^ block_word (&ks[j * 8]);
+	    }
+
+	    return;
+	}
+
+	span_copy (plain, first, words, first, nbits - first);
+
+	for (i=first; i<nbits; i += n) {
+	    n = (nbits - i < DECRYPT_BATCH) ? nbits - i : DECRYPT_BATCH;
+
+		/* Each bit's register is the 64 bits of IV and ciphertext
+		 * before it.
+		 */
+	    for (j=0; j<n; j++) {
+		int		b = i + j;
+		uint64_t	r;
+
+		if (b == 0)
+		    r = reg0;
+		else if (b < 64)
+		    r = (reg0 << b) | span_read (words, 0, b);
+		else
+		    r = span_read (words, b - 64, 64);
+
+		word_block (r, &reg[j * 8]);
+	    }
+
+	    ice_key_encrypt_many (ik, reg, ks, n);
+
+	    for (j=0; j<n; j++) {
+		int		b = i + j;
+
+		if ((ks[j * 8] & 128) != 0)
+		    plain[b >> 6] ^= (uint64_t) 1 << (63 - (b & 63));
+	    }
+	}
+}
+
+
+/*
+ * Parse and check the fields of a decrypted payload header, whose
+ * length may be at most max_length.
+ * Returns the number of message bits that follow it, or -1 if the
+ * header is not valid.
+ */
+
+static int
+header_parse (
+	const ICE_KEY	*ik,
+	const uint64_t	*plain,
+	int		max_length,
+	int		*method
+) {
+	uint64_t	fields = span_read (plain, 0, HEADER_BITS);
+	int		length, tag;
+
+	length = fields >> (HEADER_METHOD_BITS + HEADER_TAG_BITS);
+	*method = (fields >> HEADER_TAG_BITS) & ((1 << HEADER_METHOD_BITS) - 1);
+	tag = fields & ((1 << HEADER_TAG_BITS) - 1);
+
+	if (tag != header_tag (ik, length, *method) || length > max_length)
+	    return (-1);
+
+	return (length);
 }
 
 
 /*
- * Decrypt a single bit.
+ * Check a decrypted payload header, and set up the compression method
+ * it records.
+ * Returns the number of message bits that follow it, or -1 if the
+ * header is not valid.
+ */
+
+static int
+header_check (
+	CONTEXT		*ctx,
+	const uint64_t	*plain,
+	int		nbits
+) {
+	int		length, method;
+
+	if (nbits < HEADER_BITS)
+	    return (-1);
+
+	length = header_parse (ctx->ctx_encrypt->es_ice_key, plain,
+						nbits - HEADER_BITS, &method);
+	if (length < 0)
+	    return (-1);
+
+	if (!compress_method_set (ctx, method)) {
+	    fprintf (stderr, "Unknown compression method %d.\n", method);
+	    return (-1);
+	}
+
+	return (length);
+}
+
+
+/*
+ * Check the payload header at the start of a span of ciphertext,
+ * decrypting it with the given key rather than the current one.
+ * The context is only read, so keys can be checked in parallel.
+ * Returns the number of message bits, or -1 if the header is not valid.
+ */
+
+int
+password_key_check_header (
+	const CONTEXT	*ctx,
+	PASSWORD_KEY	*pk,
+	const uint64_t	*words,
+	int		nbits
+) {
+	uint64_t	plain[SPAN_WORDS (HEADER_BITS)];
+	int		method;
+
+	if (nbits < HEADER_BITS)
+	    return (-1);
+
+	span_decrypt (ctx->ctx_block_flag, pk->pk_ice, pk->pk_iv, words,
+						0, HEADER_BITS, plain);
+
+	return (header_parse (pk->pk_ice, plain, nbits - HEADER_BITS, &method));
+}
+
+
+/*
+ * Check the tag of the payload header in the first nbits bits of
+ * ciphertext, before the rest has been decoded, so the length it
+ * records can't be checked yet, and only has to fit in the header.
+ * Returns FALSE if the key doesn't match.
  */
 
 BOOL
-decrypt_bit (
-	int		bit,
+password_key_check_tag (
+	const CONTEXT	*ctx,
+	PASSWORD_KEY	*pk,
+	const uint64_t	*words,
+	int		nbits
+) {
+	uint64_t	plain[SPAN_WORDS (HEADER_BITS)];
+	int		method;
+
+	if (nbits < HEADER_BITS)
+	    return (FALSE);
+
+	span_decrypt (ctx->ctx_block_flag, pk->pk_ice, pk->pk_iv, words,
+						0, HEADER_BITS, plain);
+
+	return (header_parse (pk->pk_ice, plain, HEADER_MAX_LENGTH,
+							&method) >= 0);
+}
+
+
+/*
+ * Check that a span of ciphertext holds a whole payload under the given
+ * key, by decrypting it and checking that its header is valid and its
+ * message would uncompress. Nothing is printed.
+ * Returns FALSE if the key doesn't open it.
+ */
+
+BOOL
+password_key_check_payload (
+	CONTEXT		*ctx,
+	PASSWORD_KEY	*pk,
+	const uint64_t	*words,
+	int		nbits
+) {
+	uint64_t	plain[SPAN_WORDS (EPI_MAX_BITS)];
+	int		n, method;
+
+	if (nbits < HEADER_BITS || nbits > EPI_MAX_BITS)
+	    return (FALSE);
+
+	span_decrypt (ctx->ctx_block_flag, pk->pk_ice, pk->pk_iv, words,
+						0, HEADER_BITS, plain);
+	if ((n = header_parse (pk->pk_ice, plain, nbits - HEADER_BITS,
+							&method)) < 0)
+	    return (FALSE);
+
+	span_decrypt (ctx->ctx_block_flag, pk->pk_ice, pk->pk_iv, words,
+					HEADER_BITS, HEADER_BITS + n, plain);
+	span_copy (plain, 0, plain, HEADER_BITS, n);
+
+	return (uncompress_check (ctx, method, plain, n));
+}
+
+
+/*
+ * Decrypt a span of bits, holding all the ciphertext of a payload, and
+ * pass the message on to be uncompressed.
+ * If a payload header is being used, it is decrypted and checked first,
+ * so that a wrong key is rejected before the rest is decrypted, and
+ * then only the message bits it describes are decrypted and passed on.
+ */
+
+BOOL
+decrypt_span (
+	CONTEXT		*ctx,
+	const uint64_t	*words,
+	int		nbits,
 	FILE		*outf
 ) {
-	int		i;
-	int		nbit;
-	unsigned char	buf[8];
+	ENCRYPT_STATE	*es = ctx->ctx_encrypt;
+	const ICE_KEY	*ik = es->es_ice_key;
+	const uint64_t	*src = words;
+	uint64_t	plain[SPAN_WORDS (EPI_MAX_BITS)];
+	int		n;
 
-	if (ice_key == NULL)
-	    return (uncompress_bit (bit, outf));
+	if (nbits > EPI_MAX_BITS) {
+	    fprintf (stderr, "Error: payload is too long\n");
+	    return (FALSE);
+	}
+
+	if (ik != NULL) {
+	    n = nbits;
+	    if (ctx->ctx_header_flag && n > HEADER_BITS)
+		n = HEADER_BITS;
+
+	    span_decrypt (ctx->ctx_block_flag, ik, es->es_current_key->pk_iv,
+							words, 0, n, plain);
+	    src = plain;
+	}
 
-	ice_key_encrypt (ice_key, encrypt_iv_block, buf);
-	if ((buf[0] & 128) != 0)
-	    nbit = !bit;
-	else
-	    nbit = bit;
+	if (!ctx->ctx_header_flag)
+	    return (uncompress_span (ctx, src, nbits, outf));
 
-			/* Rotate the IV block one bit left */
-	for (i=0; i<8; i++) {
-	    encrypt_iv_block[i] <<= 1;
-	    if (i < 7 && (encrypt_iv_block[i+1] & 128) != 0)
-		encrypt_iv_block[i] |= 1;
+	if ((n = header_check (ctx, src, nbits)) < 0) {
+	    fprintf (stderr,
+		    "Payload header check failed - wrong password, %s\n",
+							"or no message.");
+	    return (FALSE);
 	}
-	encrypt_iv_block[7] |= bit;
 
-	return (uncompress_bit (nbit, outf));
+		/* Carry on from the header with the message it describes */
+	if (ik != NULL)
+	    span_decrypt (ctx->ctx_block_flag, ik, es->es_current_key->pk_iv,
+				words, HEADER_BITS, HEADER_BITS + n, plain);
+
+		/* Shift the header off the message */
+	span_copy (plain, 0, src, HEADER_BITS, n);
+
+	return (uncompress_span (ctx, plain, n, outf));
+}
+
+
+/*
+ * Decrypt a single bit. The bits are collected, and decrypted together
+ * when the decryption routines are flushed.
+ */
+
+BOOL
+decrypt_bit (
+	CONTEXT		*ctx,
+	int		bit,
+	FILE		*outf
+) {
+	ENCRYPT_STATE	*es = ctx->ctx_encrypt;
+
+	if (es->es_pending_bits == EPI_MAX_BITS) {
+	    fprintf (stderr, "Error: payload is too long\n");
+	    return (FALSE);
+	}
+
+	span_write (es->es_pending, es->es_pending_bits++, bit, 1);
+
+	return (TRUE);
 }
 
 
@@ -229,7 +1359,18 @@ decrypt_bit (
 
 BOOL
 decrypt_flush (
+	CONTEXT		*ctx,
 	FILE		*outf
 ) {
-	return (uncompress_flush (outf));
+	ENCRYPT_STATE	*es = ctx->ctx_encrypt;
+
+	if (es->es_pending_bits > 0) {
+	    int		n = es->es_pending_bits;
+
+	    es->es_pending_bits = 0;
+	    if (!decrypt_span (ctx, es->es_pending, n, outf))
+		return (FALSE);
+	}
+
+	return (uncompress_flush (ctx, outf));
 }
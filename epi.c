@@ -46,6 +46,33 @@ epi_set (
 }
 
 
+/*
+ * Convert an array of 32-bit words, least significant first, to an EPI.
+ */
+
+void
+epi_set_words (
+	EPI		*epi,
+	const uint32_t	*words,
+	int		nwords
+) {
+	int		i, j;
+
+	epi_init (epi);
+
+	for (i=0; i<nwords; i++) {
+	    uint32_t	w = words[i];
+
+	    for (j=0; j<32 && w != 0; j++) {
+		if ((w & 1) != 0)
+		    epi->epi_high_bit = i * 32 + j + 1;
+		epi->epi_bits[i * 32 + j] = w & 1;
+		w >>= 1;
+	    }
+	}
+}
+
+
 /*
  * Return the integer equivalent of an EPI.
  */
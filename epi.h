@@ -7,6 +7,8 @@
 #ifndef _EPI_H
 #define _EPI_H
 
+#include <stdint.h>
+
 #define EPI_MAX_BITS	2040
 
 typedef struct {
@@ -21,6 +23,8 @@ typedef struct {
 
 extern void	epi_init (EPI *epi);
 extern void	epi_set (EPI *epi, int n);
+extern void	epi_set_words (EPI *epi, const uint32_t *words,
+								int nwords);
 extern int	epi_cmp (const EPI *epi1, const EPI *epi2);
 extern void	epi_add (EPI *epi1, const EPI *epi2);
 extern void	epi_multiply (EPI *epi, int n);
@@ -11,13 +11,18 @@
 
 
 /*
- * Local variables.
+ * Settings of the image data coding, which are found while the images
+ * of a file are uncompressed, and used when they are compressed again
+ * so that they resemble the originals. They carry over from one image
+ * of a file to the next, but not to other files.
  */
 
-static int	block_size = 0;
-static int	clear_code_index = 0;
-static int	max_code = 0;
-static BOOL	use_end_code = FALSE;
+typedef struct {
+	int		gc_block_size;
+	int		gc_clear_code_index;
+	int		gc_max_code;
+	BOOL		gc_use_end_code;
+} GIF_CODING;
 
 
 /*
@@ -155,6 +160,7 @@ filter_extension (
 
 static int
 get_data_block (
+	GIF_CODING	*gc,
 	FILE		*fp,
 	unsigned char	*buf
 ) {
@@ -170,8 +176,8 @@ get_data_block (
 	    return (-1);
 	}
 
-	if (block_size == 0)
-	    block_size = count;
+	if (gc->gc_block_size == 0)
+	    gc->gc_block_size = count;
 
 	return (count);
 }
@@ -214,6 +220,7 @@ typedef struct {
 
 static int
 get_lwz_code (
+	GIF_CODING	*gc,
 	FILE		*fp,
 	int		code_size,
 	LWZ_BUFFER	*lb
@@ -236,7 +243,7 @@ get_lwz_code (
 	        lb->lb_buffer[1] = lb->lb_buffer[lb->lb_last_byte - 1];
 	    }
 
-	    count = get_data_block (fp, &lb->lb_buffer[2]);
+	    count = get_data_block (gc, fp, &lb->lb_buffer[2]);
 	    lb->lb_zero_data_block = (count == 0);
 
 	    if (count < 0)
@@ -267,6 +274,7 @@ get_lwz_code (
 
 static int
 lwz_read_byte (
+	GIF_CODING	*gc,
 	FILE		*fp,
 	int		input_code_size,
 	LWZ_PARAMS	*lp,
@@ -278,7 +286,7 @@ lwz_read_byte (
 	if (lp->lp_fresh) {
 	    lp->lp_fresh = FALSE;
 	    do {
-		lp->lp_old_code = get_lwz_code (fp, lp->lp_code_size, lb);
+		lp->lp_old_code = get_lwz_code (gc, fp, lp->lp_code_size, lb);
 		lp->lp_first_code = lp->lp_old_code;
 	    } while (lp->lp_first_code == lp->lp_clear_code);
 
@@ -288,10 +296,10 @@ lwz_read_byte (
 	if (lp->lp_sp > lp->lp_stack)
 	    return (*--lp->lp_sp);
 
-	while ((code = get_lwz_code (fp, lp->lp_code_size, lb)) >= 0) {
+	while ((code = get_lwz_code (gc, fp, lp->lp_code_size, lb)) >= 0) {
 	    if (code == lp->lp_clear_code) {
-		if (max_code >= clear_code_index)
-		    clear_code_index = max_code + 1;
+		if (gc->gc_max_code >= gc->gc_clear_code_index)
+		    gc->gc_clear_code_index = gc->gc_max_code + 1;
 
 		for (i=0; i<code; i++) {
 		    lp->lp_table[0][i] = 0;
@@ -305,7 +313,7 @@ lwz_read_byte (
 		lp->lp_max_code = lp->lp_clear_code + 2;
 		lp->lp_sp = lp->lp_stack;
 
-		lp->lp_old_code = get_lwz_code (fp, lp->lp_code_size, lb);
+		lp->lp_old_code = get_lwz_code (gc, fp, lp->lp_code_size, lb);
 		lp->lp_first_code = lp->lp_old_code;
 
 		return (lp->lp_first_code);
@@ -313,12 +321,12 @@ lwz_read_byte (
 		int		count;
 		unsigned char	buf[260];
 
-		use_end_code = TRUE;
+		gc->gc_use_end_code = TRUE;
 
 		if (lb->lb_zero_data_block)
 		    return (-2);
 
-		while ((count = get_data_block (fp, buf)) > 0)
+		while ((count = get_data_block (gc, fp, buf)) > 0)
 		    ;
 
 		if (count != 0)
@@ -357,8 +365,8 @@ lwz_read_byte (
 		    lp->lp_code_size++;
 		}
 
-		if (code > max_code)
-		    max_code = code;
+		if (code > gc->gc_max_code)
+		    gc->gc_max_code = code;
 	    }
 
 	    lp->lp_old_code = incode;
@@ -414,6 +422,7 @@ lwz_init (
 
 static BOOL
 load_image (
+	GIF_CODING	*gc,
 	unsigned char	*image,
 	int		size,
 	FILE		*fp
@@ -432,7 +441,7 @@ load_image (
 
 		/* Uncompress the image */
 	i = 0;
-	while ((v = lwz_read_byte (fp, c, &lwz, &lb)) >= 0) {
+	while ((v = lwz_read_byte (gc, fp, c, &lwz, &lb)) >= 0) {
 	    if (i >= size) {
 		fprintf (stderr, "Error: too much image data.\n");
 		return (FALSE);
@@ -557,6 +566,7 @@ packet_write_char (
 
 static BOOL
 output_code (
+	GIF_CODING	*gc,
 	int		code,
 	ACCUM_BITS	*ab,
 	PACKET		*p,
@@ -578,7 +588,8 @@ output_code (
 	ab->ab_num_bits += cp->cp_n_bits;
 
 	while (ab->ab_num_bits >= 8) {
-	    if (!packet_write_char (p, block_size, ab->ab_accum & 0xff, fp))
+	    if (!packet_write_char (p, gc->gc_block_size, ab->ab_accum & 0xff,
+									fp))
 		return (FALSE);
 
 	    ab->ab_accum >>= 8;
@@ -640,6 +651,7 @@ clear_hash (
 
 static BOOL
 save_compressed_image (
+	GIF_CODING		*gc,
 	int			init_bits,
 	const unsigned char	*image,
 	long int		size,
@@ -658,10 +670,10 @@ save_compressed_image (
 	cp.cp_clear_flag = FALSE;
 	cp.cp_n_bits = init_bits;
 	cp.cp_maxcode = (1 << init_bits) - 1;
-	if (block_size == 0)
-	    block_size = 254;
-	if (clear_code_index == 0)
-	    clear_code_index = 1 << MAX_LWZ_BITS;
+	if (gc->gc_block_size == 0)
+	    gc->gc_block_size = 254;
+	if (gc->gc_clear_code_index == 0)
+	    gc->gc_clear_code_index = 1 << MAX_LWZ_BITS;
 
 	clear_code = 1 << (init_bits - 1);
 	eof_code = clear_code + 1;
@@ -678,7 +690,7 @@ save_compressed_image (
 
 	clear_hash (htab);		/* Clear hash table */
 
-	if (!output_code (clear_code, &ab, &p, &cp, fp))
+	if (!output_code (gc, clear_code, &ab, &p, &cp, fp))
 	    return (FALSE);
 
 	ent = image[image_idx++];
@@ -714,12 +726,12 @@ save_compressed_image (
 		}
 	    }
 
-	    if (!output_code (ent, &ab, &p, &cp, fp))
+	    if (!output_code (gc, ent, &ab, &p, &cp, fp))
 		return (FALSE);
 
 	    ent = c;
 
-	    if (cp.cp_free_ent < clear_code_index) {
+	    if (cp.cp_free_ent < gc->gc_clear_code_index) {
 		codetab[i] = cp.cp_free_ent++;	/* Add code to hashtable */
 		htab[i] = fcode;
 	    } else {				/* Clear the hashtable */
@@ -727,20 +739,22 @@ save_compressed_image (
 		cp.cp_free_ent = clear_code + 2;
 		cp.cp_clear_flag = TRUE;
 
-		if (!output_code (clear_code, &ab, &p, &cp, fp))
+		if (!output_code (gc, clear_code, &ab, &p, &cp, fp))
 		    return (FALSE);
 	    }
 	}
 
 		/* Put out the final code */
-	if (!output_code (ent, &ab, &p, &cp, fp))
+	if (!output_code (gc, ent, &ab, &p, &cp, fp))
 	    return (FALSE);
-	if (use_end_code && !output_code (eof_code, &ab, &p, &cp, fp))
+	if (gc->gc_use_end_code
+		&& !output_code (gc, eof_code, &ab, &p, &cp, fp))
 	    return (FALSE);
 
 			/* At EOF, write the rest of the buffer */
 	while (ab.ab_num_bits > 0) {
-	    if (!packet_write_char (&p, block_size, ab.ab_accum & 0xff, fp))
+	    if (!packet_write_char (&p, gc->gc_block_size,
+						ab.ab_accum & 0xff, fp))
 		return (FALSE);
 
 	    ab.ab_accum >>= 8;
@@ -760,6 +774,7 @@ save_compressed_image (
 
 static BOOL
 save_image (
+	GIF_CODING		*gc,
 	const unsigned char	*image,
 	int			bpp,
 	long int		size,
@@ -777,7 +792,7 @@ save_image (
 	    return (FALSE);
 	}
 
-	if (!save_compressed_image (init_code_size + 1, image, size, fp))
+	if (!save_compressed_image (gc, init_code_size + 1, image, size, fp))
 	    return (FALSE);
 
 		/* Write out a zero-length packet (to end the series) */
@@ -796,13 +811,14 @@ save_image (
 
 static BOOL
 filter_image (
+	GIF_CODING	*gc,
 	const GIFINFO	*gi,
 	const int	*imap,
 	FILE		*infp,
 	FILE		*outfp
 ) {
 	unsigned char	buf[9], *image;
-	BOOL		local_cmap;
+	BOOL		local_cmap, ok;
 	int		width, height;
 	long int	i, size;
 	int		bpp = gi->gi_bits_per_pixel;
@@ -851,7 +867,7 @@ filter_image (
 	    return (FALSE);
 	}
 
-	if (!load_image (image, size, infp)) {
+	if (!load_image (gc, image, size, infp)) {
 	    free (image);
 	    return (FALSE);
 	}
@@ -861,7 +877,10 @@ filter_image (
 		image[i] = imap[image[i]];
 	}
 
-	return (save_image (image, bpp, size, outfp));
+	ok = save_image (gc, image, bpp, size, outfp);
+	free (image);
+
+	return (ok);
 }
 
 
@@ -891,6 +910,12 @@ gif_filter_save (
 	int		i, n = gi->gi_num_colours;
 	int		cidx[256];
 	unsigned char	buf[768];
+	GIF_CODING	gc;
+
+	gc.gc_block_size = 0;
+	gc.gc_clear_code_index = 0;
+	gc.gc_max_code = 0;
+	gc.gc_use_end_code = FALSE;
 
 		/* Create a cross-mapping table for the colours */
 	for (i=0; i<n; i++) {
@@ -945,7 +970,7 @@ gif_filter_save (
 			return (FALSE);
 		    break;
 		case ',':
-		    if (!filter_image (gi, cidx, infp, outfp))
+		    if (!filter_image (&gc, gi, cidx, infp, outfp))
 			return (FALSE);
 		    break;
 		default:
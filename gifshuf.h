@@ -8,6 +8,7 @@
 #define _GIFSHUF_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 
 /*
@@ -26,44 +27,262 @@ typedef int	BOOL;
 
 
 /*
- * Define global variables.
+ * The state of each stage of processing, private to its module.
  */
 
-extern BOOL	compress_flag;
-extern BOOL	quiet_flag;
-extern BOOL	v1_flag;
+typedef struct encrypt_state_struct	ENCRYPT_STATE;
+typedef struct compress_state_struct	COMPRESS_STATE;
+typedef struct encode_state_struct	ENCODE_STATE;
+typedef struct arith_state_struct	ARITH_STATE;
+typedef struct dict_state_struct	DICT_STATE;
+
+
+/*
+ * An open palette cache, which a context may use.
+ */
+
+typedef struct pcache_struct		PCACHE;
+
+
+/*
+ * A processing context, holding the options and the state of every
+ * stage. It is passed down through all the routines, so contexts share
+ * nothing, and carriers can be processed at the same time, one per
+ * context. The command-line program uses just one.
+ * The options are set before the first message, and only read after
+ * that. The method a message actually uses, as chosen automatically or
+ * read from its header, is kept in the compression state.
+ */
+
+typedef struct {
+	BOOL		ctx_compress_flag;
+	BOOL		ctx_quiet_flag;
+	BOOL		ctx_v1_flag;
+	BOOL		ctx_group_flag;
+	BOOL		ctx_block_flag;
+	BOOL		ctx_fixed_key_flag;
+	BOOL		ctx_header_flag;
+	int		ctx_compress_method;
+	int		ctx_compress_table;
+	int		ctx_compress_dict;
+
+	ENCRYPT_STATE	*ctx_encrypt;
+	COMPRESS_STATE	*ctx_compress;
+	ENCODE_STATE	*ctx_encode;
+	ARITH_STATE	*ctx_arith;
+	DICT_STATE	*ctx_dict;
+	PCACHE		*ctx_pcache;	/* NULL if none is used */
+} CONTEXT;
+
+
+/*
+ * The optional payload header, which precedes the message bits.
+ * It holds the number of message bits that follow, the compression
+ * method used, and a check tag computed with the key.
+ */
+
+#define HEADER_LENGTH_BITS	11
+#define HEADER_METHOD_BITS	4
+#define HEADER_TAG_BITS		12
+#define HEADER_BITS		(HEADER_LENGTH_BITS + HEADER_METHOD_BITS \
+							+ HEADER_TAG_BITS)
+
+#define HUFF_TABLES		4	/* Built-in Huffman code tables */
+
+#define METHOD_NONE		0
+#define METHOD_HUFFMAN		1	/* Plus the Huffman table ID */
+#define METHOD_RANGE		(METHOD_HUFFMAN + HUFF_TABLES)
+#define METHOD_CM		(METHOD_RANGE + 1)
+#define METHOD_DICT		(METHOD_CM + 1)
+
+/*
+ * With automatic selection, the smallest of the methods above is chosen
+ * when embedding. The value itself is never stored.
+ * Without a payload header, every method but Huffman coding, which
+ * gifshuffle 2.0 stored untagged, stores its ID as a tag of
+ * HEADER_METHOD_BITS bits ahead of the message, and extraction with
+ * any of those methods uses the method in the tag.
+ */
+
+#define METHOD_AUTO		((1 << HEADER_METHOD_BITS) - 1)
+
+
+/*
+ * Preset dictionaries for the dictionary method. The built-in ones are
+ * numbered from 0, and one loaded from a file is given an ID from
+ * DICT_FILE_ID up, derived from its contents. The ID is stored in
+ * DICT_ID_BITS bits ahead of the compressed message. Since a file's ID
+ * holds only 7 bits of its hash, it is followed by DICT_CHECK_BITS more,
+ * so that extraction with the wrong file is almost always caught.
+ */
+
+#define DICT_BUILTINS		3
+#define DICT_FILE_ID		128
+#define DICT_ID_BITS		8
+#define DICT_CHECK_BITS		16
+#define DICT_MAX_BYTES		16384
+
+
+/*
+ * The built-in Huffman code tables, as (code, length) pairs generated
+ * by mkhuff into hufftab.h, and their names.
+ */
+
+#define HUFF_MAX_LENGTH		24
+
+typedef struct {
+	uint32_t	hc_code;
+	int		hc_length;
+} HUFF_CODE;
+
+extern const HUFF_CODE	huff_codes[HUFF_TABLES][256];
+extern const char	*huff_table_names[HUFF_TABLES];
+
+
+/*
+ * Spans of payload bits, packed most significant bit first into 64-bit
+ * words.
+ */
+
+#define SPAN_WORDS(nbits)	(((nbits) + 63) >> 6)
+#define SPAN_BIT(words, pos)	((int) ((words)[(pos) >> 6] \
+						>> (63 - ((pos) & 63))) & 1)
+
+
+/*
+ * A handle to a key built from a password.
+ */
+
+typedef struct password_key_struct	PASSWORD_KEY;
+
+
+/*
+ * A carrier file, loaded once so it can be checked against many keys.
+ */
+
+typedef struct carrier_struct		CARRIER;
 
 
 /*
  * Define external functions.
  */
 
-extern void	password_set (const char *passwd);
-extern BOOL	encrypting_colourmap ();
-extern void	encrypt_colour (unsigned char r, unsigned char g,
-				unsigned char b, unsigned char *ctext);
+extern CONTEXT	*context_create (void);
+extern void	context_destroy (CONTEXT *ctx);
+
+extern ENCRYPT_STATE	*encrypt_state_create (void);
+extern void	encrypt_state_destroy (ENCRYPT_STATE *es);
+extern COMPRESS_STATE	*compress_state_create (void);
+extern void	compress_state_destroy (COMPRESS_STATE *cs);
+extern ENCODE_STATE	*encode_state_create (void);
+extern void	encode_state_destroy (ENCODE_STATE *en);
+extern ARITH_STATE	*arith_state_create (void);
+extern void	arith_state_destroy (ARITH_STATE *as);
+extern DICT_STATE	*dict_state_create (void);
+extern void	dict_state_destroy (DICT_STATE *ds);
+
+extern void	password_set (CONTEXT *ctx, const char *passwd);
+extern PASSWORD_KEY	*password_key_get (const CONTEXT *ctx,
+						const char *passwd);
+extern void	password_key_release (PASSWORD_KEY *pk);
+extern void	password_key_use (CONTEXT *ctx, PASSWORD_KEY *pk);
+extern BOOL	encrypting_colourmap (CONTEXT *ctx);
+extern uint64_t	encrypt_key_id (CONTEXT *ctx);
+extern void	encrypt_colour (CONTEXT *ctx, unsigned char r,
+			unsigned char g, unsigned char b, unsigned char *ctext);
+extern void	encrypt_colours (CONTEXT *ctx, int n,
+			const unsigned char *rgb, unsigned char *ctext);
+extern void	password_key_encrypt_colours (PASSWORD_KEY *pk, int n,
+			const unsigned char *rgb, unsigned char *ctext);
+extern int	password_key_check_header (const CONTEXT *ctx,
+			PASSWORD_KEY *pk, const uint64_t *words, int nbits);
+extern BOOL	password_key_check_tag (const CONTEXT *ctx,
+			PASSWORD_KEY *pk, const uint64_t *words, int nbits);
+extern BOOL	password_key_check_payload (CONTEXT *ctx, PASSWORD_KEY *pk,
+					const uint64_t *words, int nbits);
+
+extern BOOL	message_extract (CONTEXT *ctx, FILE *inf, FILE *outf);
+extern CARRIER	*carrier_load (const CONTEXT *ctx, FILE *fp);
+extern void	carrier_free (CARRIER *c);
+extern int	carrier_key_check (const CONTEXT *ctx, const CARRIER *c,
+							PASSWORD_KEY *pk);
+extern BOOL	carrier_key_confirm (CONTEXT *ctx, const CARRIER *c,
+							PASSWORD_KEY *pk);
+extern BOOL	keyring_extract (CONTEXT *ctx, const char *ring_path,
+						char **files, int nfiles);
+extern int	message_capacity (const CONTEXT *ctx, FILE *fp, int *total,
+								int *loss);
+extern void	space_calculate (const CONTEXT *ctx, FILE *inf);
+
+extern int	huff_table_find (const char *name);
+extern const char	*huff_table_name (int table);
+extern int	compress_method_find (const char *name);
+extern const char	*compress_method_name (int id);
+extern int	compress_method_id (const CONTEXT *ctx);
+extern BOOL	compress_method_set (CONTEXT *ctx, int id);
+
+typedef BOOL	(*ARITH_OUTPUT) (CONTEXT *ctx, uint64_t word, int nbits,
+						FILE *inf, FILE *outf);
+
+extern void	arith_dictionary_set (CONTEXT *ctx,
+				const unsigned char *dict, int len);
+extern void	arith_encode_init (CONTEXT *ctx, int method,
+							ARITH_OUTPUT output);
+extern BOOL	arith_encode_byte (CONTEXT *ctx, int c, FILE *inf,
+								FILE *outf);
+extern BOOL	arith_encode_flush (CONTEXT *ctx, FILE *inf, FILE *outf);
+extern int	arith_encoded_bits (CONTEXT *ctx);
+extern int	arith_encoded_size (CONTEXT *ctx, int method,
+					const unsigned char *buf, int n);
+extern int	arith_decode (CONTEXT *ctx, int method, const uint64_t *words,
+				int nbits, unsigned char *buf, int maxlen);
+
+extern int	dict_find (CONTEXT *ctx, const char *name);
+extern const char	*dict_name (int id);
+extern BOOL	dict_select (CONTEXT *ctx, int id);
+extern int	dict_id_bits (int id);
+extern int	dict_check (const CONTEXT *ctx);
+extern BOOL	dict_verify (const CONTEXT *ctx, int check);
+extern BOOL	dict_match (const CONTEXT *ctx, int id, int check);
 
-extern BOOL	message_extract (FILE *inf, FILE *outf);
-extern void	space_calculate (FILE *inf);
+extern void	compress_init (CONTEXT *ctx);
+extern BOOL	compress_bit (CONTEXT *ctx, int bit, FILE *inf, FILE *outf);
+extern BOOL	compress_bytes (CONTEXT *ctx, const unsigned char *buf,
+					int n, FILE *inf, FILE *outf);
+extern BOOL	compress_flush (CONTEXT *ctx, FILE *inf, FILE *outf);
 
-extern void	compress_init (void);
-extern BOOL	compress_bit (int bit, FILE *inf, FILE *outf);
-extern BOOL	compress_flush (FILE *inf, FILE *outf);
+extern void	uncompress_init (CONTEXT *ctx);
+extern BOOL	uncompress_span (CONTEXT *ctx, const uint64_t *words,
+						int nbits, FILE *outf);
+extern BOOL	uncompress_bit (CONTEXT *ctx, int bit, FILE *outf);
+extern BOOL	uncompress_flush (CONTEXT *ctx, FILE *outf);
+extern BOOL	uncompress_check (CONTEXT *ctx, int id, const uint64_t *words,
+								int nbits);
 
-extern void	uncompress_init (void);
-extern BOOL	uncompress_bit (int bit, FILE *outf);
-extern BOOL	uncompress_flush (FILE *outf);
+extern void	encrypt_init (CONTEXT *ctx);
+extern BOOL	encrypt_span (CONTEXT *ctx, const uint64_t *words, int nbits,
+						FILE *inf, FILE *outf);
+extern BOOL	encrypt_bit (CONTEXT *ctx, int bit, FILE *inf, FILE *outf);
+extern BOOL	encrypt_word (CONTEXT *ctx, uint64_t word, int nbits,
+						FILE *inf, FILE *outf);
+extern BOOL	encrypt_flush (CONTEXT *ctx, FILE *inf, FILE *outf);
 
-extern void	encrypt_init (void);
-extern BOOL	encrypt_bit (int bit, FILE *inf, FILE *outf);
-extern BOOL	encrypt_flush (FILE *inf, FILE *outf);
+extern void	decrypt_init (CONTEXT *ctx);
+extern BOOL	decrypt_bit (CONTEXT *ctx, int bit, FILE *outf);
+extern BOOL	decrypt_span (CONTEXT *ctx, const uint64_t *words, int nbits,
+								FILE *outf);
+extern BOOL	decrypt_flush (CONTEXT *ctx, FILE *outf);
 
-extern void	decrypt_init (void);
-extern BOOL	decrypt_bit (int bit, FILE *outf);
-extern BOOL	decrypt_flush (FILE *outf);
+extern void	encode_init (CONTEXT *ctx);
+extern BOOL	encode_span (CONTEXT *ctx, const uint64_t *words, int nbits,
+						FILE *inf, FILE *outf);
+extern BOOL	encode_bit (CONTEXT *ctx, int bit, FILE *inf, FILE *outf);
+extern BOOL	encode_flush (CONTEXT *ctx, FILE *inf, FILE *outf);
 
-extern void	encode_init (void);
-extern BOOL	encode_bit (int bit, FILE *inf, FILE *outf);
-extern BOOL	encode_flush (FILE *inf, FILE *outf);
+extern uint64_t	span_read (const uint64_t *words, int pos, int nbits);
+extern void	span_write (uint64_t *words, int pos, uint64_t value,
+								int nbits);
+extern void	span_copy (uint64_t *dst, int dst_pos, const uint64_t *src,
+						int src_pos, int nbits);
 
 #endif
@@ -0,0 +1,88 @@
+/*
+ * Library interface to the gifshuffle steganography program.
+ * Messages are hidden in, and extracted from, GIF images held in
+ * memory, with the same options as the command-line program.
+ *
+ * Each call is independent of the others, so calls can be made from
+ * several threads at once. Errors are reported on stderr.
+ * Each one-shot call creates and destroys a context of about 800KB,
+ * most of it the models of the arithmetic coder, which are only
+ * touched by the methods that use them. This costs a few microseconds
+ * a call. The coding tables and password keys are built once, on first
+ * use, and shared read-only by the whole process.
+ * A program that handles many carriers with the same options can open
+ * a handle, which keeps the encrypted colours and colour orderings it
+ * has worked out between calls. A handle may be used by only one
+ * thread at a time, but each thread can have its own.
+ */
+
+#ifndef _GIFSHUFFLE_H
+#define _GIFSHUFFLE_H
+
+#include <stddef.h>
+
+
+/*
+ * Options for hiding and extracting messages. A NULL pointer, or
+ * zero, leaves an option off, and the matching command-line option
+ * is shown for each. Giving a compression method, table or dictionary
+ * turns on compression.
+ */
+
+typedef struct {
+	int		gso_compress;		/* -C */
+	const char	*gso_method;		/* -M method */
+	const char	*gso_table;		/* -T table */
+	const char	*gso_dict;		/* -D dict */
+	const char	*gso_password;		/* -p passwd */
+	int		gso_v1;			/* -1 */
+	int		gso_group;		/* -G */
+	int		gso_block;		/* -B */
+	int		gso_fixed_key;		/* -K */
+	int		gso_header;		/* -H */
+} GIFSHUFFLE_OPTIONS;
+
+
+/*
+ * A handle holding a set of options, and what has been worked out
+ * under them.
+ */
+
+typedef struct gifshuffle_struct	GIFSHUFFLE;
+
+
+/*
+ * Define external functions.
+ * gifshuffle_embed() and gifshuffle_extract() return nonzero on
+ * success, giving a buffer that must be freed with gifshuffle_free().
+ * gifshuffle_capacity() returns the number of message bits the carrier
+ * can hold, or -1 on error.
+ * gifshuffle_open() returns a handle for a set of options, or NULL if
+ * they are not valid, which is passed to the _with() forms of these
+ * functions, and released with gifshuffle_close().
+ */
+
+extern int	gifshuffle_embed (const unsigned char *carrier,
+			size_t carrier_len, const unsigned char *msg,
+			size_t msg_len, const GIFSHUFFLE_OPTIONS *opts,
+			unsigned char **out, size_t *out_len);
+extern int	gifshuffle_extract (const unsigned char *carrier,
+			size_t carrier_len, const GIFSHUFFLE_OPTIONS *opts,
+			unsigned char **msg, size_t *msg_len);
+extern long	gifshuffle_capacity (const unsigned char *carrier,
+			size_t carrier_len, const GIFSHUFFLE_OPTIONS *opts);
+extern void	gifshuffle_free (void *buf);
+
+extern GIFSHUFFLE	*gifshuffle_open (const GIFSHUFFLE_OPTIONS *opts);
+extern void	gifshuffle_close (GIFSHUFFLE *gs);
+extern int	gifshuffle_embed_with (GIFSHUFFLE *gs,
+			const unsigned char *carrier, size_t carrier_len,
+			const unsigned char *msg, size_t msg_len,
+			unsigned char **out, size_t *out_len);
+extern int	gifshuffle_extract_with (GIFSHUFFLE *gs,
+			const unsigned char *carrier, size_t carrier_len,
+			unsigned char **msg, size_t *msg_len);
+extern long	gifshuffle_capacity_with (GIFSHUFFLE *gs,
+			const unsigned char *carrier, size_t carrier_len);
+
+#endif
@@ -0,0 +1,256 @@
+"111111110000010",	/* 0 - 0.00% */
+"111111110000011",	/* 1 - 0.00% */
+"111111110000100",	/* 2 - 0.00% */
+"111111110000101",	/* 3 - 0.00% */
+"111111110000110",	/* 4 - 0.00% */
+"111111110000111",	/* 5 - 0.00% */
+"111111110001000",	/* 6 - 0.00% */
+"111111110001001",	/* 7 - 0.00% */
+"111111110001010",	/* 8 - 0.00% */
+"111111110001011",	/* 9 - 0.00% */
+"1111100",		/* 10 - 1.30% */
+"111111110001100",	/* 11 - 0.00% */
+"111111110001101",	/* 12 - 0.00% */
+"111111110001110",	/* 13 - 0.00% */
+"111111110001111",	/* 14 - 0.00% */
+"111111110010000",	/* 15 - 0.00% */
+"111111110010001",	/* 16 - 0.00% */
+"111111110010010",	/* 17 - 0.00% */
+"111111110010011",	/* 18 - 0.00% */
+"111111110010100",	/* 19 - 0.00% */
+"111111110010101",	/* 20 - 0.00% */
+"111111110010110",	/* 21 - 0.00% */
+"111111110010111",	/* 22 - 0.00% */
+"111111110011000",	/* 23 - 0.00% */
+"111111110011001",	/* 24 - 0.00% */
+"111111110011010",	/* 25 - 0.00% */
+"111111110011011",	/* 26 - 0.00% */
+"111111110011100",	/* 27 - 0.00% */
+"111111110011101",	/* 28 - 0.00% */
+"111111110011110",	/* 29 - 0.00% */
+"111111110011111",	/* 30 - 0.00% */
+"111111110100000",	/* 31 - 0.00% */
+"111111110100001",	/* ' ' - 0.00% */
+"111111110100010",	/* '!' - 0.00% */
+"111111110100011",	/* '"' - 0.00% */
+"111111110100100",	/* '#' - 0.00% */
+"111111110100101",	/* '$' - 0.00% */
+"111111110100110",	/* '%' - 0.00% */
+"111111110100111",	/* '&' - 0.00% */
+"111111110101000",	/* ''' - 0.00% */
+"111111110101001",	/* '(' - 0.00% */
+"111111110101010",	/* ')' - 0.00% */
+"111111110101011",	/* '*' - 0.00% */
+"000000",		/* '+' - 1.55% */
+"111111110101100",	/* ',' - 0.00% */
+"111111110101101",	/* '-' - 0.00% */
+"111111110101110",	/* '.' - 0.00% */
+"000001",		/* '/' - 1.59% */
+"000010",		/* '0' - 1.59% */
+"000011",		/* '1' - 1.51% */
+"000100",		/* '2' - 1.46% */
+"000101",		/* '3' - 1.60% */
+"000110",		/* '4' - 1.59% */
+"000111",		/* '5' - 1.51% */
+"001000",		/* '6' - 1.54% */
+"001001",		/* '7' - 1.52% */
+"001010",		/* '8' - 1.45% */
+"001011",		/* '9' - 1.61% */
+"111111110101111",	/* ':' - 0.00% */
+"111111110110000",	/* ';' - 0.00% */
+"111111110110001",	/* '<' - 0.00% */
+"111111110110010",	/* '=' - 0.00% */
+"111111110110011",	/* '>' - 0.00% */
+"111111110110100",	/* '?' - 0.00% */
+"111111110110101",	/* '@' - 0.00% */
+"001100",		/* 'A' - 1.48% */
+"001101",		/* 'B' - 1.50% */
+"001110",		/* 'C' - 1.59% */
+"001111",		/* 'D' - 1.53% */
+"010000",		/* 'E' - 1.51% */
+"010001",		/* 'F' - 1.43% */
+"010010",		/* 'G' - 1.62% */
+"010011",		/* 'H' - 1.69% */
+"010100",		/* 'I' - 1.60% */
+"010101",		/* 'J' - 1.53% */
+"010110",		/* 'K' - 1.52% */
+"010111",		/* 'L' - 1.45% */
+"011000",		/* 'M' - 1.61% */
+"011001",		/* 'N' - 1.59% */
+"011010",		/* 'O' - 1.54% */
+"011011",		/* 'P' - 1.48% */
+"011100",		/* 'Q' - 1.56% */
+"1111101",		/* 'R' - 1.42% */
+"011101",		/* 'S' - 1.57% */
+"011110",		/* 'T' - 1.66% */
+"011111",		/* 'U' - 1.57% */
+"100000",		/* 'V' - 1.63% */
+"100001",		/* 'W' - 1.54% */
+"100010",		/* 'X' - 1.59% */
+"100011",		/* 'Y' - 1.53% */
+"100100",		/* 'Z' - 1.54% */
+"111111110110110",	/* '[' - 0.00% */
+"111111110110111",	/* '\' - 0.00% */
+"111111110111000",	/* ']' - 0.00% */
+"111111110111001",	/* '^' - 0.00% */
+"111111110111010",	/* '_' - 0.00% */
+"111111110111011",	/* '`' - 0.00% */
+"100101",		/* 'a' - 1.51% */
+"1111110",		/* 'b' - 1.38% */
+"100110",		/* 'c' - 1.56% */
+"100111",		/* 'd' - 1.48% */
+"101000",		/* 'e' - 1.63% */
+"101001",		/* 'f' - 1.51% */
+"101010",		/* 'g' - 1.60% */
+"101011",		/* 'h' - 1.59% */
+"101100",		/* 'i' - 1.51% */
+"101101",		/* 'j' - 1.54% */
+"101110",		/* 'k' - 1.59% */
+"101111",		/* 'l' - 1.59% */
+"110000",		/* 'm' - 1.53% */
+"110001",		/* 'n' - 1.45% */
+"110010",		/* 'o' - 1.71% */
+"110011",		/* 'p' - 1.58% */
+"110100",		/* 'q' - 1.45% */
+"110101",		/* 'r' - 1.51% */
+"110110",		/* 's' - 1.47% */
+"110111",		/* 't' - 1.62% */
+"111000",		/* 'u' - 1.61% */
+"111001",		/* 'v' - 1.57% */
+"111010",		/* 'w' - 1.44% */
+"111011",		/* 'x' - 1.60% */
+"111100",		/* 'y' - 1.44% */
+"111101",		/* 'z' - 1.44% */
+"111111110111100",	/* '{' - 0.00% */
+"111111110111101",	/* '|' - 0.00% */
+"111111110111110",	/* '}' - 0.00% */
+"111111110111111",	/* '~' - 0.00% */
+"111111111000000",	/* 127 - 0.00% */
+"111111111000001",	/* 128 - 0.00% */
+"111111111000010",	/* 129 - 0.00% */
+"111111111000011",	/* 130 - 0.00% */
+"111111111000100",	/* 131 - 0.00% */
+"111111111000101",	/* 132 - 0.00% */
+"111111111000110",	/* 133 - 0.00% */
+"111111111000111",	/* 134 - 0.00% */
+"111111111001000",	/* 135 - 0.00% */
+"111111111001001",	/* 136 - 0.00% */
+"111111111001010",	/* 137 - 0.00% */
+"111111111001011",	/* 138 - 0.00% */
+"111111111001100",	/* 139 - 0.00% */
+"111111111001101",	/* 140 - 0.00% */
+"111111111001110",	/* 141 - 0.00% */
+"111111111001111",	/* 142 - 0.00% */
+"111111111010000",	/* 143 - 0.00% */
+"111111111010001",	/* 144 - 0.00% */
+"111111111010010",	/* 145 - 0.00% */
+"111111111010011",	/* 146 - 0.00% */
+"111111111010100",	/* 147 - 0.00% */
+"111111111010101",	/* 148 - 0.00% */
+"111111111010110",	/* 149 - 0.00% */
+"111111111010111",	/* 150 - 0.00% */
+"111111111011000",	/* 151 - 0.00% */
+"111111111011001",	/* 152 - 0.00% */
+"111111111011010",	/* 153 - 0.00% */
+"111111111011011",	/* 154 - 0.00% */
+"111111111011100",	/* 155 - 0.00% */
+"111111111011101",	/* 156 - 0.00% */
+"111111111011110",	/* 157 - 0.00% */
+"111111111011111",	/* 158 - 0.00% */
+"111111111100000",	/* 159 - 0.00% */
+"111111111100001",	/* 160 - 0.00% */
+"111111111100010",	/* 161 - 0.00% */
+"111111111100011",	/* 162 - 0.00% */
+"111111111100100",	/* 163 - 0.00% */
+"111111111100101",	/* 164 - 0.00% */
+"111111111100110",	/* 165 - 0.00% */
+"111111111100111",	/* 166 - 0.00% */
+"111111111101000",	/* 167 - 0.00% */
+"111111111101001",	/* 168 - 0.00% */
+"111111111101010",	/* 169 - 0.00% */
+"111111111101011",	/* 170 - 0.00% */
+"111111111101100",	/* 171 - 0.00% */
+"111111111101101",	/* 172 - 0.00% */
+"111111111101110",	/* 173 - 0.00% */
+"111111111101111",	/* 174 - 0.00% */
+"111111111110000",	/* 175 - 0.00% */
+"111111111110001",	/* 176 - 0.00% */
+"111111111110010",	/* 177 - 0.00% */
+"111111111110011",	/* 178 - 0.00% */
+"111111111110100",	/* 179 - 0.00% */
+"111111111110101",	/* 180 - 0.00% */
+"111111111110110",	/* 181 - 0.00% */
+"111111111110111",	/* 182 - 0.00% */
+"111111111111000",	/* 183 - 0.00% */
+"111111111111001",	/* 184 - 0.00% */
+"111111111111010",	/* 185 - 0.00% */
+"111111111111011",	/* 186 - 0.00% */
+"111111111111100",	/* 187 - 0.00% */
+"111111111111101",	/* 188 - 0.00% */
+"111111111111110",	/* 189 - 0.00% */
+"111111111111111",	/* 190 - 0.00% */
+"11111110000000",	/* 191 - 0.00% */
+"11111110000001",	/* 192 - 0.00% */
+"11111110000010",	/* 193 - 0.00% */
+"11111110000011",	/* 194 - 0.00% */
+"11111110000100",	/* 195 - 0.00% */
+"11111110000101",	/* 196 - 0.00% */
+"11111110000110",	/* 197 - 0.00% */
+"11111110000111",	/* 198 - 0.00% */
+"11111110001000",	/* 199 - 0.00% */
+"11111110001001",	/* 200 - 0.00% */
+"11111110001010",	/* 201 - 0.00% */
+"11111110001011",	/* 202 - 0.00% */
+"11111110001100",	/* 203 - 0.00% */
+"11111110001101",	/* 204 - 0.00% */
+"11111110001110",	/* 205 - 0.00% */
+"11111110001111",	/* 206 - 0.00% */
+"11111110010000",	/* 207 - 0.00% */
+"11111110010001",	/* 208 - 0.00% */
+"11111110010010",	/* 209 - 0.00% */
+"11111110010011",	/* 210 - 0.00% */
+"11111110010100",	/* 211 - 0.00% */
+"11111110010101",	/* 212 - 0.00% */
+"11111110010110",	/* 213 - 0.00% */
+"11111110010111",	/* 214 - 0.00% */
+"11111110011000",	/* 215 - 0.00% */
+"11111110011001",	/* 216 - 0.00% */
+"11111110011010",	/* 217 - 0.00% */
+"11111110011011",	/* 218 - 0.00% */
+"11111110011100",	/* 219 - 0.00% */
+"11111110011101",	/* 220 - 0.00% */
+"11111110011110",	/* 221 - 0.00% */
+"11111110011111",	/* 222 - 0.00% */
+"11111110100000",	/* 223 - 0.00% */
+"11111110100001",	/* 224 - 0.00% */
+"11111110100010",	/* 225 - 0.00% */
+"11111110100011",	/* 226 - 0.00% */
+"11111110100100",	/* 227 - 0.00% */
+"11111110100101",	/* 228 - 0.00% */
+"11111110100110",	/* 229 - 0.00% */
+"11111110100111",	/* 230 - 0.00% */
+"11111110101000",	/* 231 - 0.00% */
+"11111110101001",	/* 232 - 0.00% */
+"11111110101010",	/* 233 - 0.00% */
+"11111110101011",	/* 234 - 0.00% */
+"11111110101100",	/* 235 - 0.00% */
+"11111110101101",	/* 236 - 0.00% */
+"11111110101110",	/* 237 - 0.00% */
+"11111110101111",	/* 238 - 0.00% */
+"11111110110000",	/* 239 - 0.00% */
+"11111110110001",	/* 240 - 0.00% */
+"11111110110010",	/* 241 - 0.00% */
+"11111110110011",	/* 242 - 0.00% */
+"11111110110100",	/* 243 - 0.00% */
+"11111110110101",	/* 244 - 0.00% */
+"11111110110110",	/* 245 - 0.00% */
+"11111110110111",	/* 246 - 0.00% */
+"11111110111000",	/* 247 - 0.00% */
+"11111110111001",	/* 248 - 0.00% */
+"11111110111010",	/* 249 - 0.00% */
+"11111110111011",	/* 250 - 0.00% */
+"11111110111100",	/* 251 - 0.00% */
+"11111110111101",	/* 252 - 0.00% */
+"11111110111110",	/* 253 - 0.00% */
+"11111110111111",	/* 254 - 0.00% */
+"11111111000000"	/* 255 - 0.00% */
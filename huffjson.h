@@ -0,0 +1,256 @@
+"111111101000100",	/* 0 - 0.00% */
+"111111101000101",	/* 1 - 0.00% */
+"111111101000110",	/* 2 - 0.00% */
+"111111101000111",	/* 3 - 0.00% */
+"111111101001000",	/* 4 - 0.00% */
+"111111101001001",	/* 5 - 0.00% */
+"111111101001010",	/* 6 - 0.00% */
+"111111101001011",	/* 7 - 0.00% */
+"111111101001100",	/* 8 - 0.00% */
+"111111101001101",	/* 9 - 0.00% */
+"01100",		/* 10 - 2.44% */
+"111111101001110",	/* 11 - 0.00% */
+"111111101001111",	/* 12 - 0.00% */
+"111111101010000",	/* 13 - 0.00% */
+"111111101010001",	/* 14 - 0.00% */
+"111111101010010",	/* 15 - 0.00% */
+"111111101010011",	/* 16 - 0.00% */
+"111111101010100",	/* 17 - 0.00% */
+"111111101010101",	/* 18 - 0.00% */
+"111111101010110",	/* 19 - 0.00% */
+"111111101010111",	/* 20 - 0.00% */
+"111111101011000",	/* 21 - 0.00% */
+"111111101011001",	/* 22 - 0.00% */
+"111111101011010",	/* 23 - 0.00% */
+"111111101011011",	/* 24 - 0.00% */
+"111111101011100",	/* 25 - 0.00% */
+"111111101011101",	/* 26 - 0.00% */
+"111111101011110",	/* 27 - 0.00% */
+"111111101011111",	/* 28 - 0.00% */
+"111111101100000",	/* 29 - 0.00% */
+"111111101100001",	/* 30 - 0.00% */
+"111111101100010",	/* 31 - 0.00% */
+"0010",			/* ' ' - 6.61% */
+"111111101100011",	/* '!' - 0.00% */
+"000",			/* '"' - 15.06% */
+"111111101100100",	/* '#' - 0.00% */
+"111111101100101",	/* '$' - 0.00% */
+"111111101100110",	/* '%' - 0.00% */
+"111111101100111",	/* '&' - 0.00% */
+"111111101101000",	/* ''' - 0.00% */
+"111111101101001",	/* '(' - 0.00% */
+"111111101101010",	/* ')' - 0.00% */
+"111111101101011",	/* '*' - 0.00% */
+"111111101101100",	/* '+' - 0.00% */
+"01101",		/* ',' - 4.14% */
+"1101110",		/* '-' - 0.77% */
+"101110",		/* '.' - 1.16% */
+"111111101101101",	/* '/' - 0.00% */
+"101111",		/* '0' - 1.89% */
+"110000",		/* '1' - 1.82% */
+"110001",		/* '2' - 1.90% */
+"110010",		/* '3' - 1.11% */
+"110011",		/* '4' - 1.15% */
+"1101111",		/* '5' - 1.07% */
+"1110000",		/* '6' - 0.87% */
+"1110001",		/* '7' - 0.94% */
+"1110010",		/* '8' - 1.04% */
+"1110011",		/* '9' - 0.96% */
+"0011",			/* ':' - 5.41% */
+"111111101101110",	/* ';' - 0.00% */
+"111111101101111",	/* '<' - 0.00% */
+"111111101110000",	/* '=' - 0.00% */
+"111111101110001",	/* '>' - 0.00% */
+"111111101110010",	/* '?' - 0.00% */
+"11110010",		/* '@' - 0.39% */
+"11111110100000",	/* 'A' - 0.01% */
+"1111101110",		/* 'B' - 0.10% */
+"11111101100",		/* 'C' - 0.07% */
+"1111101111",		/* 'D' - 0.07% */
+"11111101101",		/* 'E' - 0.06% */
+"1111111001100",	/* 'F' - 0.02% */
+"1111111001101",	/* 'G' - 0.01% */
+"1111111001110",	/* 'H' - 0.01% */
+"111111100100",		/* 'I' - 0.02% */
+"1111110000",		/* 'J' - 0.09% */
+"111111101110011",	/* 'K' - 0.00% */
+"11111101110",		/* 'L' - 0.04% */
+"11111101111",		/* 'M' - 0.07% */
+"111111100101",		/* 'N' - 0.02% */
+"11111110000",		/* 'O' - 0.06% */
+"1111110001",		/* 'P' - 0.08% */
+"111111101110100",	/* 'Q' - 0.00% */
+"11111110001",		/* 'R' - 0.05% */
+"1111110010",		/* 'S' - 0.09% */
+"11110011",		/* 'T' - 0.53% */
+"111111101110101",	/* 'U' - 0.00% */
+"1111111001111",	/* 'V' - 0.01% */
+"1111110011",		/* 'W' - 0.15% */
+"111111101110110",	/* 'X' - 0.00% */
+"111111101110111",	/* 'Y' - 0.00% */
+"11110100",		/* 'Z' - 0.39% */
+"11110101",		/* '[' - 0.39% */
+"111111101111000",	/* '\' - 0.00% */
+"11110110",		/* ']' - 0.39% */
+"111111101111001",	/* '^' - 0.00% */
+"111111101111010",	/* '_' - 0.00% */
+"111111101111011",	/* '`' - 0.00% */
+"0100",			/* 'a' - 5.15% */
+"111110110",		/* 'b' - 0.24% */
+"01110",		/* 'c' - 2.74% */
+"01111",		/* 'd' - 2.63% */
+"0101",			/* 'e' - 6.12% */
+"11110111",		/* 'f' - 0.30% */
+"110100",		/* 'g' - 1.29% */
+"11111000",		/* 'h' - 0.46% */
+"10000",		/* 'i' - 3.11% */
+"1111110100",		/* 'j' - 0.14% */
+"1111110101",		/* 'k' - 0.11% */
+"110101",		/* 'l' - 2.01% */
+"10001",		/* 'm' - 2.21% */
+"10010",		/* 'n' - 2.50% */
+"10011",		/* 'o' - 2.89% */
+"110110",		/* 'p' - 1.12% */
+"111111101111100",	/* 'q' - 0.00% */
+"10100",		/* 'r' - 3.06% */
+"10101",		/* 's' - 3.71% */
+"10110",		/* 't' - 3.81% */
+"1110100",		/* 'u' - 1.03% */
+"1110101",		/* 'v' - 0.95% */
+"11111001",		/* 'w' - 0.36% */
+"11111010",		/* 'x' - 0.39% */
+"1110110",		/* 'y' - 0.76% */
+"111111101111101",	/* 'z' - 0.00% */
+"1110111",		/* '{' - 0.77% */
+"111111101111110",	/* '|' - 0.00% */
+"1111000",		/* '}' - 0.77% */
+"111111101111111",	/* '~' - 0.00% */
+"111111110000000",	/* 127 - 0.00% */
+"111111110000001",	/* 128 - 0.00% */
+"111111110000010",	/* 129 - 0.00% */
+"111111110000011",	/* 130 - 0.00% */
+"111111110000100",	/* 131 - 0.00% */
+"111111110000101",	/* 132 - 0.00% */
+"111111110000110",	/* 133 - 0.00% */
+"111111110000111",	/* 134 - 0.00% */
+"111111110001000",	/* 135 - 0.00% */
+"111111110001001",	/* 136 - 0.00% */
+"111111110001010",	/* 137 - 0.00% */
+"111111110001011",	/* 138 - 0.00% */
+"111111110001100",	/* 139 - 0.00% */
+"111111110001101",	/* 140 - 0.00% */
+"111111110001110",	/* 141 - 0.00% */
+"111111110001111",	/* 142 - 0.00% */
+"111111110010000",	/* 143 - 0.00% */
+"111111110010001",	/* 144 - 0.00% */
+"111111110010010",	/* 145 - 0.00% */
+"111111110010011",	/* 146 - 0.00% */
+"111111110010100",	/* 147 - 0.00% */
+"111111110010101",	/* 148 - 0.00% */
+"111111110010110",	/* 149 - 0.00% */
+"111111110010111",	/* 150 - 0.00% */
+"111111110011000",	/* 151 - 0.00% */
+"111111110011001",	/* 152 - 0.00% */
+"111111110011010",	/* 153 - 0.00% */
+"111111110011011",	/* 154 - 0.00% */
+"111111110011100",	/* 155 - 0.00% */
+"111111110011101",	/* 156 - 0.00% */
+"111111110011110",	/* 157 - 0.00% */
+"111111110011111",	/* 158 - 0.00% */
+"111111110100000",	/* 159 - 0.00% */
+"111111110100001",	/* 160 - 0.00% */
+"111111110100010",	/* 161 - 0.00% */
+"111111110100011",	/* 162 - 0.00% */
+"111111110100100",	/* 163 - 0.00% */
+"111111110100101",	/* 164 - 0.00% */
+"111111110100110",	/* 165 - 0.00% */
+"111111110100111",	/* 166 - 0.00% */
+"111111110101000",	/* 167 - 0.00% */
+"111111110101001",	/* 168 - 0.00% */
+"111111110101010",	/* 169 - 0.00% */
+"111111110101011",	/* 170 - 0.00% */
+"111111110101100",	/* 171 - 0.00% */
+"111111110101101",	/* 172 - 0.00% */
+"111111110101110",	/* 173 - 0.00% */
+"111111110101111",	/* 174 - 0.00% */
+"111111110110000",	/* 175 - 0.00% */
+"111111110110001",	/* 176 - 0.00% */
+"111111110110010",	/* 177 - 0.00% */
+"111111110110011",	/* 178 - 0.00% */
+"111111110110100",	/* 179 - 0.00% */
+"111111110110101",	/* 180 - 0.00% */
+"111111110110110",	/* 181 - 0.00% */
+"111111110110111",	/* 182 - 0.00% */
+"111111110111000",	/* 183 - 0.00% */
+"111111110111001",	/* 184 - 0.00% */
+"111111110111010",	/* 185 - 0.00% */
+"111111110111011",	/* 186 - 0.00% */
+"111111110111100",	/* 187 - 0.00% */
+"111111110111101",	/* 188 - 0.00% */
+"111111110111110",	/* 189 - 0.00% */
+"111111110111111",	/* 190 - 0.00% */
+"111111111000000",	/* 191 - 0.00% */
+"111111111000001",	/* 192 - 0.00% */
+"111111111000010",	/* 193 - 0.00% */
+"111111111000011",	/* 194 - 0.00% */
+"111111111000100",	/* 195 - 0.00% */
+"111111111000101",	/* 196 - 0.00% */
+"111111111000110",	/* 197 - 0.00% */
+"111111111000111",	/* 198 - 0.00% */
+"111111111001000",	/* 199 - 0.00% */
+"111111111001001",	/* 200 - 0.00% */
+"111111111001010",	/* 201 - 0.00% */
+"111111111001011",	/* 202 - 0.00% */
+"111111111001100",	/* 203 - 0.00% */
+"111111111001101",	/* 204 - 0.00% */
+"111111111001110",	/* 205 - 0.00% */
+"111111111001111",	/* 206 - 0.00% */
+"111111111010000",	/* 207 - 0.00% */
+"111111111010001",	/* 208 - 0.00% */
+"111111111010010",	/* 209 - 0.00% */
+"111111111010011",	/* 210 - 0.00% */
+"111111111010100",	/* 211 - 0.00% */
+"111111111010101",	/* 212 - 0.00% */
+"111111111010110",	/* 213 - 0.00% */
+"111111111010111",	/* 214 - 0.00% */
+"111111111011000",	/* 215 - 0.00% */
+"111111111011001",	/* 216 - 0.00% */
+"111111111011010",	/* 217 - 0.00% */
+"111111111011011",	/* 218 - 0.00% */
+"111111111011100",	/* 219 - 0.00% */
+"111111111011101",	/* 220 - 0.00% */
+"111111111011110",	/* 221 - 0.00% */
+"111111111011111",	/* 222 - 0.00% */
+"111111111100000",	/* 223 - 0.00% */
+"111111111100001",	/* 224 - 0.00% */
+"111111111100010",	/* 225 - 0.00% */
+"111111111100011",	/* 226 - 0.00% */
+"111111111100100",	/* 227 - 0.00% */
+"111111111100101",	/* 228 - 0.00% */
+"111111111100110",	/* 229 - 0.00% */
+"111111111100111",	/* 230 - 0.00% */
+"111111111101000",	/* 231 - 0.00% */
+"111111111101001",	/* 232 - 0.00% */
+"111111111101010",	/* 233 - 0.00% */
+"111111111101011",	/* 234 - 0.00% */
+"111111111101100",	/* 235 - 0.00% */
+"111111111101101",	/* 236 - 0.00% */
+"111111111101110",	/* 237 - 0.00% */
+"111111111101111",	/* 238 - 0.00% */
+"111111111110000",	/* 239 - 0.00% */
+"111111111110001",	/* 240 - 0.00% */
+"111111111110010",	/* 241 - 0.00% */
+"111111111110011",	/* 242 - 0.00% */
+"111111111110100",	/* 243 - 0.00% */
+"111111111110101",	/* 244 - 0.00% */
+"111111111110110",	/* 245 - 0.00% */
+"111111111110111",	/* 246 - 0.00% */
+"111111111111000",	/* 247 - 0.00% */
+"111111111111001",	/* 248 - 0.00% */
+"111111111111010",	/* 249 - 0.00% */
+"111111111111011",	/* 250 - 0.00% */
+"111111111111100",	/* 251 - 0.00% */
+"111111111111101",	/* 252 - 0.00% */
+"111111111111110",	/* 253 - 0.00% */
+"111111111111111",	/* 254 - 0.00% */
+"11111110100001"	/* 255 - 0.00% */
@@ -0,0 +1,8 @@
+/*
+ * The built-in Huffman code tables of the gifshuffle steganography
+ * program, generated by mkhuff.
+ */
+
+#include "gifshuf.h"
+
+#include "hufftab.h"
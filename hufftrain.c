@@ -0,0 +1,193 @@
+/*
+ * Train a Huffman code table for the gifshuffle steganography program.
+ * Byte frequencies are counted over a sample corpus, read from the
+ * files named on the command line or standard input, and a code table
+ * in the same format as huffcode.h is written to standard output.
+ */
+
+#include <stdio.h>
+
+
+/*
+ * The longest code allowed. Codes are kept well inside the limit
+ * accepted by mkhuff, so that the decoding subtables stay small.
+ */
+
+#define TRAIN_MAX_LENGTH	20
+
+
+/*
+ * Count the bytes in a file.
+ */
+
+static int
+bytes_count (
+	FILE		*fp,
+	unsigned long	*counts
+) {
+	int		c;
+
+	while ((c = fgetc (fp)) != EOF)
+	    counts[c]++;
+
+	return (ferror (fp) == 0);
+}
+
+
+/*
+ * Calculate Huffman code lengths from symbol weights.
+ * The two lightest nodes are repeatedly merged. With only 256 symbols
+ * a simple linear search for them is fast enough.
+ * Returns the length of the longest code.
+ */
+
+static int
+code_lengths_build (
+	const unsigned long	*weights,
+	int			*lengths
+) {
+	unsigned long		w[511];
+	int			parent[511];
+	int			i, n, max_len = 0;
+
+	for (i=0; i<256; i++)
+	    w[i] = weights[i];
+	for (i=0; i<511; i++)
+	    parent[i] = -1;
+
+	for (n = 256; n < 511; n++) {
+	    int		a = -1, b = -1;
+
+	    for (i=0; i<n; i++) {
+		if (parent[i] >= 0)
+		    continue;
+		if (a < 0 || w[i] < w[a]) {
+		    b = a;
+		    a = i;
+		} else if (b < 0 || w[i] < w[b])
+		    b = i;
+	    }
+
+	    w[n] = w[a] + w[b];
+	    parent[a] = parent[b] = n;
+	}
+
+	for (i=0; i<256; i++) {
+	    int		j, len = 0;
+
+	    for (j = i; parent[j] >= 0; j = parent[j])
+		len++;
+
+	    lengths[i] = len;
+	    if (len > max_len)
+		max_len = len;
+	}
+
+	return (max_len);
+}
+
+
+/*
+ * Assign canonical codes to a set of code lengths.
+ * Codes are given out in order of length, then symbol.
+ */
+
+static void
+canonical_codes (
+	const int	*lengths,
+	unsigned long	*codes
+) {
+	unsigned long	code = 0;
+	int		len, i;
+
+	for (len = 1; len <= TRAIN_MAX_LENGTH; len++) {
+	    for (i=0; i<256; i++)
+		if (lengths[i] == len)
+		    codes[i] = code++;
+	    code <<= 1;
+	}
+}
+
+
+/*
+ * Program's starting point.
+ * Counts the corpus, builds the code, and prints it.
+ */
+
+int
+main (
+	int		argc,
+	char		*argv[]
+) {
+	unsigned long	counts[256], weights[256], total = 0;
+	unsigned long	codes[256];
+	int		lengths[256];
+	int		i, shift;
+
+	for (i=0; i<256; i++)
+	    counts[i] = 0;
+
+	if (argc < 2) {
+	    if (!bytes_count (stdin, counts)) {
+		perror ("stdin");
+		return (1);
+	    }
+	} else {
+	    for (i=1; i<argc; i++) {
+		FILE	*fp;
+
+		if ((fp = fopen (argv[i], "rb")) == NULL
+					|| !bytes_count (fp, counts)) {
+		    perror (argv[i]);
+		    return (1);
+		}
+		fclose (fp);
+	    }
+	}
+
+	for (i=0; i<256; i++)
+	    total += counts[i];
+
+		/* Every byte needs a code, even if the corpus lacks it.
+		 * If the code is too long, flatten the weights and retry.
+		 */
+	for (shift = 0; ; shift++) {
+	    for (i=0; i<256; i++)
+		weights[i] = (counts[i] >> shift) + 1;
+
+	    if (code_lengths_build (weights, lengths) <= TRAIN_MAX_LENGTH)
+		break;
+	}
+
+	canonical_codes (lengths, codes);
+
+	for (i=0; i<256; i++) {
+	    int		b, col;
+
+	    putchar ('"');
+	    for (b = lengths[i] - 1; b >= 0; b--)
+		putchar (((codes[i] >> b) & 1) ? '1' : '0');
+	    putchar ('"');
+	    col = lengths[i] + 2;
+
+	    if (i < 255) {
+		putchar (',');
+		col++;
+	    }
+
+	    do {
+		putchar ('\t');
+		col = (col + 8) & ~7;
+	    } while (col < 24);
+
+	    if (i >= ' ' && i < 127)
+		printf ("/* '%c' - ", i);
+	    else
+		printf ("/* %d - ", i);
+
+	    printf ("%.2f%% */\n", total == 0 ? 0.0
+				: (double) counts[i] / total * 100.0);
+	}
+
+	return (0);
+}
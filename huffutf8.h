@@ -0,0 +1,256 @@
+"111101110010",		/* 0 - 0.00% */
+"111101110011",		/* 1 - 0.00% */
+"111101110100",		/* 2 - 0.00% */
+"111101110101",		/* 3 - 0.00% */
+"111101110110",		/* 4 - 0.00% */
+"111101110111",		/* 5 - 0.00% */
+"111101111000",		/* 6 - 0.00% */
+"111101111001",		/* 7 - 0.00% */
+"111101111010",		/* 8 - 0.00% */
+"111101111011",		/* 9 - 0.00% */
+"1011010",		/* 10 - 1.15% */
+"111101111100",		/* 11 - 0.00% */
+"111101111101",		/* 12 - 0.00% */
+"111101111110",		/* 13 - 0.00% */
+"111101111111",		/* 14 - 0.00% */
+"111110000000",		/* 15 - 0.00% */
+"111110000001",		/* 16 - 0.00% */
+"111110000010",		/* 17 - 0.00% */
+"111110000011",		/* 18 - 0.00% */
+"111110000100",		/* 19 - 0.00% */
+"111110000101",		/* 20 - 0.00% */
+"111110000110",		/* 21 - 0.00% */
+"111110000111",		/* 22 - 0.00% */
+"111110001000",		/* 23 - 0.00% */
+"111110001001",		/* 24 - 0.00% */
+"111110001010",		/* 25 - 0.00% */
+"111110001011",		/* 26 - 0.00% */
+"111110001100",		/* 27 - 0.00% */
+"111110001101",		/* 28 - 0.00% */
+"111110001110",		/* 29 - 0.00% */
+"111110001111",		/* 30 - 0.00% */
+"111110010000",		/* 31 - 0.00% */
+"000",			/* ' ' - 11.18% */
+"11110100000",		/* '!' - 0.02% */
+"111110010001",		/* '"' - 0.00% */
+"111110010010",		/* '#' - 0.00% */
+"111110010011",		/* '$' - 0.00% */
+"111110010100",		/* '%' - 0.00% */
+"111110010101",		/* '&' - 0.00% */
+"1110111110",		/* ''' - 0.07% */
+"111110010110",		/* '(' - 0.00% */
+"111110010111",		/* ')' - 0.00% */
+"111110011000",		/* '*' - 0.00% */
+"111110011001",		/* '+' - 0.00% */
+"11010100",		/* ',' - 0.58% */
+"11110100001",		/* '-' - 0.05% */
+"100000",		/* '.' - 1.30% */
+"111110011010",		/* '/' - 0.00% */
+"111110011011",		/* '0' - 0.00% */
+"111110011100",		/* '1' - 0.00% */
+"111110011101",		/* '2' - 0.00% */
+"111110011110",		/* '3' - 0.00% */
+"111110011111",		/* '4' - 0.00% */
+"111110100000",		/* '5' - 0.00% */
+"111110100001",		/* '6' - 0.00% */
+"111110100010",		/* '7' - 0.00% */
+"111110100011",		/* '8' - 0.00% */
+"111110100100",		/* '9' - 0.00% */
+"111110100101",		/* ':' - 0.00% */
+"11110100010",		/* ';' - 0.05% */
+"111110100110",		/* '<' - 0.00% */
+"111110100111",		/* '=' - 0.00% */
+"111110101000",		/* '>' - 0.00% */
+"11110100011",		/* '?' - 0.02% */
+"111110101001",		/* '@' - 0.00% */
+"11110100100",		/* 'A' - 0.02% */
+"111010110",		/* 'B' - 0.14% */
+"111110101010",		/* 'C' - 0.00% */
+"1110111111",		/* 'D' - 0.10% */
+"11110100101",		/* 'E' - 0.02% */
+"1111000000",		/* 'F' - 0.10% */
+"1111000001",		/* 'G' - 0.07% */
+"11110100110",		/* 'H' - 0.05% */
+"11110100111",		/* 'I' - 0.05% */
+"11110101000",		/* 'J' - 0.02% */
+"111110101011",		/* 'K' - 0.00% */
+"1111000010",		/* 'L' - 0.12% */
+"111110101100",		/* 'M' - 0.00% */
+"11110101001",		/* 'N' - 0.05% */
+"11110101010",		/* 'O' - 0.02% */
+"1111000011",		/* 'P' - 0.12% */
+"111110101101",		/* 'Q' - 0.00% */
+"111110101110",		/* 'R' - 0.00% */
+"111010111",		/* 'S' - 0.26% */
+"1111000100",		/* 'T' - 0.10% */
+"1111000101",		/* 'U' - 0.07% */
+"11110101011",		/* 'V' - 0.02% */
+"11110101100",		/* 'W' - 0.02% */
+"111110101111",		/* 'X' - 0.00% */
+"111110110000",		/* 'Y' - 0.00% */
+"11110101101",		/* 'Z' - 0.02% */
+"111110110001",		/* '[' - 0.00% */
+"111110110010",		/* '\' - 0.00% */
+"111110110011",		/* ']' - 0.00% */
+"111110110100",		/* '^' - 0.00% */
+"111110110101",		/* '_' - 0.00% */
+"111110110110",		/* '`' - 0.00% */
+"01010",		/* 'a' - 3.14% */
+"11010101",		/* 'b' - 0.50% */
+"1011011",		/* 'c' - 0.82% */
+"100001",		/* 'd' - 1.32% */
+"0010",			/* 'e' - 5.23% */
+"11010110",		/* 'f' - 0.41% */
+"11010111",		/* 'g' - 0.53% */
+"1011100",		/* 'h' - 0.77% */
+"01011",		/* 'i' - 2.54% */
+"11011000",		/* 'j' - 0.38% */
+"11011001",		/* 'k' - 0.58% */
+"100010",		/* 'l' - 1.54% */
+"1011101",		/* 'm' - 1.01% */
+"01100",		/* 'n' - 3.02% */
+"100011",		/* 'o' - 2.11% */
+"1011110",		/* 'p' - 0.70% */
+"1111000110",		/* 'q' - 0.12% */
+"01101",		/* 'r' - 2.95% */
+"100100",		/* 's' - 2.35% */
+"100101",		/* 't' - 1.92% */
+"100110",		/* 'u' - 1.44% */
+"11011010",		/* 'v' - 0.43% */
+"11011011",		/* 'w' - 0.38% */
+"11110101110",		/* 'x' - 0.05% */
+"11011100",		/* 'y' - 0.48% */
+"1011111",		/* 'z' - 0.89% */
+"111110110111",		/* '{' - 0.00% */
+"111110111000",		/* '|' - 0.00% */
+"111110111001",		/* '}' - 0.00% */
+"111110111010",		/* '~' - 0.00% */
+"111110111011",		/* 127 - 0.00% */
+"1100000",		/* 128 - 0.94% */
+"1100001",		/* 129 - 1.18% */
+"100111",		/* 130 - 1.49% */
+"1100010",		/* 131 - 0.84% */
+"1100011",		/* 132 - 0.72% */
+"11011101",		/* 133 - 0.29% */
+"1111000111",		/* 134 - 0.10% */
+"11011110",		/* 135 - 0.43% */
+"1111001000",		/* 136 - 0.12% */
+"111011000",		/* 137 - 0.19% */
+"111110111100",		/* 138 - 0.00% */
+"111011001",		/* 139 - 0.26% */
+"11011111",		/* 140 - 0.43% */
+"11110101111",		/* 141 - 0.05% */
+"11110110000",		/* 142 - 0.05% */
+"11100000",		/* 143 - 0.29% */
+"111110111101",		/* 144 - 0.00% */
+"1111001001",		/* 145 - 0.07% */
+"1111001010",		/* 146 - 0.07% */
+"111110111110",		/* 147 - 0.00% */
+"111110111111",		/* 148 - 0.00% */
+"11110110001",		/* 149 - 0.02% */
+"111111000000",		/* 150 - 0.00% */
+"11110110010",		/* 151 - 0.02% */
+"111111000001",		/* 152 - 0.00% */
+"111011010",		/* 153 - 0.17% */
+"111111000010",		/* 154 - 0.00% */
+"1111001011",		/* 155 - 0.10% */
+"11110110011",		/* 156 - 0.05% */
+"11110110100",		/* 157 - 0.05% */
+"111111000011",		/* 158 - 0.00% */
+"11100001",		/* 159 - 0.36% */
+"111011011",		/* 160 - 0.22% */
+"1111001100",		/* 161 - 0.10% */
+"111111000100",		/* 162 - 0.00% */
+"111111000101",		/* 163 - 0.00% */
+"1111001101",		/* 164 - 0.12% */
+"111111000110",		/* 165 - 0.00% */
+"11110110101",		/* 166 - 0.02% */
+"111111000111",		/* 167 - 0.00% */
+"11110110110",		/* 168 - 0.05% */
+"111011100",		/* 169 - 0.14% */
+"11110110111",		/* 170 - 0.02% */
+"111111001000",		/* 171 - 0.00% */
+"111011101",		/* 172 - 0.19% */
+"11100010",		/* 173 - 0.41% */
+"1111001110",		/* 174 - 0.10% */
+"111011110",		/* 175 - 0.26% */
+"1100100",		/* 176 - 1.03% */
+"101000",		/* 177 - 1.58% */
+"11100011",		/* 178 - 0.58% */
+"11100100",		/* 179 - 0.48% */
+"11100101",		/* 180 - 0.46% */
+"101001",		/* 181 - 2.40% */
+"11100110",		/* 182 - 0.29% */
+"11100111",		/* 183 - 0.53% */
+"1100101",		/* 184 - 0.89% */
+"1100110",		/* 185 - 0.62% */
+"11101000",		/* 186 - 0.50% */
+"11101001",		/* 187 - 0.53% */
+"101010",		/* 188 - 1.27% */
+"1100111",		/* 189 - 1.01% */
+"101011",		/* 190 - 1.39% */
+"1101000",		/* 191 - 0.84% */
+"111111001001",		/* 192 - 0.00% */
+"111111001010",		/* 193 - 0.00% */
+"1111001111",		/* 194 - 0.05% */
+"101100",		/* 195 - 1.20% */
+"1101001",		/* 196 - 0.84% */
+"11101010",		/* 197 - 0.41% */
+"111111001011",		/* 198 - 0.00% */
+"111111001100",		/* 199 - 0.00% */
+"111111001101",		/* 200 - 0.00% */
+"111111001110",		/* 201 - 0.00% */
+"111111001111",		/* 202 - 0.00% */
+"111111010000",		/* 203 - 0.00% */
+"111111010001",		/* 204 - 0.00% */
+"111111010010",		/* 205 - 0.00% */
+"0011",			/* 206 - 4.94% */
+"01110",		/* 207 - 2.42% */
+"0100",			/* 208 - 9.79% */
+"01111",		/* 209 - 4.65% */
+"111111010011",		/* 210 - 0.00% */
+"111111010100",		/* 211 - 0.00% */
+"111111010101",		/* 212 - 0.00% */
+"111111010110",		/* 213 - 0.00% */
+"111111010111",		/* 214 - 0.00% */
+"111111011000",		/* 215 - 0.00% */
+"111111011001",		/* 216 - 0.00% */
+"111111011010",		/* 217 - 0.00% */
+"111111011011",		/* 218 - 0.00% */
+"111111011100",		/* 219 - 0.00% */
+"111111011101",		/* 220 - 0.00% */
+"111111011110",		/* 221 - 0.00% */
+"111111011111",		/* 222 - 0.00% */
+"111111100000",		/* 223 - 0.00% */
+"111111100001",		/* 224 - 0.00% */
+"111111100010",		/* 225 - 0.00% */
+"111111100011",		/* 226 - 0.00% */
+"111111100100",		/* 227 - 0.00% */
+"111111100101",		/* 228 - 0.00% */
+"111111100110",		/* 229 - 0.00% */
+"111111100111",		/* 230 - 0.00% */
+"111111101000",		/* 231 - 0.00% */
+"111111101001",		/* 232 - 0.00% */
+"111111101010",		/* 233 - 0.00% */
+"111111101011",		/* 234 - 0.00% */
+"111111101100",		/* 235 - 0.00% */
+"111111101101",		/* 236 - 0.00% */
+"111111101110",		/* 237 - 0.00% */
+"111111101111",		/* 238 - 0.00% */
+"111111110000",		/* 239 - 0.00% */
+"111111110001",		/* 240 - 0.00% */
+"111111110010",		/* 241 - 0.00% */
+"111111110011",		/* 242 - 0.00% */
+"111111110100",		/* 243 - 0.00% */
+"111111110101",		/* 244 - 0.00% */
+"111111110110",		/* 245 - 0.00% */
+"111111110111",		/* 246 - 0.00% */
+"111111111000",		/* 247 - 0.00% */
+"111111111001",		/* 248 - 0.00% */
+"111111111010",		/* 249 - 0.00% */
+"111111111011",		/* 250 - 0.00% */
+"111111111100",		/* 251 - 0.00% */
+"111111111101",		/* 252 - 0.00% */
+"111111111110",		/* 253 - 0.00% */
+"111111111111",		/* 254 - 0.00% */
+"11110111000"		/* 255 - 0.00% */
@@ -7,10 +7,16 @@
 #include "ice.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define ICE_HAVE_AVX2
+#include <immintrin.h>
+#endif
 
 
 	/* Structure of a single round subkey */
-typedef unsigned long	ICE_SUBKEY[3];
+typedef uint32_t	ICE_SUBKEY[3];
 
 
 	/* Internal structure of the ICE_KEY structure */
@@ -18,37 +24,13 @@ struct ice_key_struct {
 	int		ik_size;
 	int		ik_rounds;
 	ICE_SUBKEY	*ik_keysched;
+	void		(*ik_encrypt) (const ICE_KEY *ik,
+			    const unsigned char *ptext, unsigned char *ctext);
 };
 
-	/* The S-boxes */
-static unsigned long	ice_sbox[4][1024];
-static int		ice_sboxes_initialised = 0;
-
-
-	/* Modulo values for the S-boxes */
-static const int	ice_smod[4][4] = {
-				{333, 313, 505, 369},
-				{379, 375, 319, 391},
-				{361, 445, 451, 397},
-				{397, 425, 395, 505}};
-
-	/* XOR values for the S-boxes */
-static const int	ice_sxor[4][4] = {
-				{0x83, 0x85, 0x9b, 0xcd},
-				{0xcc, 0xa7, 0xad, 0x41},
-				{0x4b, 0x2e, 0xd4, 0x33},
-				{0xea, 0xcb, 0x2e, 0x04}};
-
-	/* Expanded permutation values for the P-box */
-static const unsigned long	ice_pbox[32] = {
-		0x00000001, 0x00000080, 0x00000400, 0x00002000,
-		0x00080000, 0x00200000, 0x01000000, 0x40000000,
-		0x00000008, 0x00000020, 0x00000100, 0x00004000,
-		0x00010000, 0x00800000, 0x04000000, 0x20000000,
-		0x00000004, 0x00000010, 0x00000200, 0x00008000,
-		0x00020000, 0x00400000, 0x08000000, 0x10000000,
-		0x00000002, 0x00000040, 0x00000800, 0x00001000,
-		0x00040000, 0x00100000, 0x02000000, 0x80000000};
+	/* The S-boxes, generated by mkice */
+#include "icetab.h"
+
 
 	/* The key rotation schedule */
 static const int	ice_keyrot[16] = {
@@ -56,107 +38,15 @@ static const int	ice_keyrot[16] = {
 				1, 3, 2, 0, 3, 1, 0, 2};
 
 
-/*
- * Galois Field multiplication of a by b, modulo m.
- * Just like arithmetic multiplication, except that additions and
- * subtractions are replaced by XOR.
- */
-
-static unsigned int
-gf_mult (
-	register unsigned int	a,
-	register unsigned int	b,
-	register unsigned int	m
-) {
-	register unsigned int	res = 0;
-
-	while (b) {
-	    if (b & 1)
-		res ^= a;
-
-	    a <<= 1;
-	    b >>= 1;
-
-	    if (a >= 256)
-		a ^= m;
-	}
-
-	return (res);
-}
-
-
-/*
- * Galois Field exponentiation.
- * Raise the base to the power of 7, modulo m.
- */
-
-static unsigned long
-gf_exp7 (
-	register unsigned int	b,
-	unsigned int		m
-) {
-	register unsigned int	x;
-
-	if (b == 0)
-	    return (0);
-
-	x = gf_mult (b, b, m);
-	x = gf_mult (b, x, m);
-	x = gf_mult (x, x, m);
-	return (gf_mult (b, x, m));
-}
-
-
-/*
- * Carry out the ICE 32-bit P-box permutation.
- */
-
-static unsigned long
-ice_perm32 (
-	register unsigned long	x
-) {
-	register unsigned long		res = 0;
-	register const unsigned long	*pbox = ice_pbox;
-
-	while (x) {
-	    if (x & 1)
-		res |= *pbox;
-	    pbox++;
-	    x >>= 1;
-	}
-
-	return (res);
-}
-
-
-/*
- * Initialise the ICE S-boxes.
- * This only has to be done once.
- */
-
-static void
-ice_sboxes_init (void)
-{
-	register int	i;
-
-	for (i=0; i<1024; i++) {
-	    int			col = (i >> 1) & 0xff;
-	    int			row = (i & 0x1) | ((i & 0x200) >> 8);
-	    unsigned long	x;
-
-	    x = gf_exp7 (col ^ ice_sxor[0][row], ice_smod[0][row]) << 24;
-	    ice_sbox[0][i] = ice_perm32 (x);
-
-	    x = gf_exp7 (col ^ ice_sxor[1][row], ice_smod[1][row]) << 16;
-	    ice_sbox[1][i] = ice_perm32 (x);
-
-	    x = gf_exp7 (col ^ ice_sxor[2][row], ice_smod[2][row]) << 8;
-	    ice_sbox[2][i] = ice_perm32 (x);
-
-	    x = gf_exp7 (col ^ ice_sxor[3][row], ice_smod[3][row]);
-	    ice_sbox[3][i] = ice_perm32 (x);
-	}
-}
+	/* Encryption functions, specialised by number of rounds */
+static void	ice_encrypt_generic (const ICE_KEY *ik,
+			const unsigned char *ptext, unsigned char *ctext);
+static void	ice_encrypt_8 (const ICE_KEY *ik,
+			const unsigned char *ptext, unsigned char *ctext);
+static void	ice_encrypt_16 (const ICE_KEY *ik,
+			const unsigned char *ptext, unsigned char *ctext);
+static void	ice_encrypt_32 (const ICE_KEY *ik,
+			const unsigned char *ptext, unsigned char *ctext);
 
 
 /*
@@ -169,11 +59,6 @@ ice_key_create (
 ) {
 	ICE_KEY		*ik;
 
-	if (!ice_sboxes_initialised) {
-	    ice_sboxes_init ();
-	    ice_sboxes_initialised = 1;
-	}
-
 	if ((ik = (ICE_KEY *) malloc (sizeof (ICE_KEY))) == NULL)
 	    return (NULL);
 
@@ -191,6 +76,22 @@ ice_key_create (
 	    return (NULL);
 	}
 
+		/* Pick the encryption function for the number of rounds */
+	switch (ik->ik_rounds) {
+	    case 8:
+		ik->ik_encrypt = ice_encrypt_8;
+		break;
+	    case 16:
+		ik->ik_encrypt = ice_encrypt_16;
+		break;
+	    case 32:
+		ik->ik_encrypt = ice_encrypt_32;
+		break;
+	    default:
+		ik->ik_encrypt = ice_encrypt_generic;
+		break;
+	}
+
 	return (ik);
 }
 
@@ -226,13 +127,13 @@ ice_key_destroy (
  * The single round ICE f function.
  */
 
-static unsigned long
+static inline uint32_t
 ice_f (
-	register unsigned long	p,
+	uint32_t		p,
 	const ICE_SUBKEY	sk
 ) {
-	unsigned long	tl, tr;		/* Expanded 40-bit values */
-	unsigned long	al, ar;		/* Salted expanded 40-bit values */
+	uint32_t	tl, tr;		/* Expanded 40-bit values */
+	uint32_t	al, ar;		/* Salted expanded 40-bit values */
 
 					/* Left half expansion */
 	tl = ((p >> 16) & 0x3ff) | (((p >> 14) | (p << 18)) & 0xffc00);
@@ -256,8 +157,96 @@ ice_f (
 }
 
 
+/*
+ * Load a block of 8 bytes into two 32-bit halves.
+ */
+
+#define ICE_LOAD(text, l, r)	\
+	l = (((uint32_t) text[0]) << 24) | (((uint32_t) text[1]) << 16) \
+			| (((uint32_t) text[2]) << 8) | text[3]; \
+	r = (((uint32_t) text[4]) << 24) | (((uint32_t) text[5]) << 16) \
+			| (((uint32_t) text[6]) << 8) | text[7]
+
+
+/*
+ * Store two 32-bit halves into a block of 8 bytes, swapping them.
+ */
+
+#define ICE_STORE(text, l, r)	\
+	text[0] = r >> 24; text[1] = r >> 16; text[2] = r >> 8; text[3] = r; \
+	text[4] = l >> 24; text[5] = l >> 16; text[6] = l >> 8; text[7] = l
+
+
+/*
+ * Unrolled encryption rounds, two and eight at a time.
+ */
+
+#define ICE_ROUND2(ks, n, l, r)	\
+	l ^= ice_f (r, ks[n]); r ^= ice_f (l, ks[n + 1])
+
+#define ICE_ROUND8(ks, n, l, r)	\
+	ICE_ROUND2 (ks, n, l, r); ICE_ROUND2 (ks, n + 2, l, r); \
+	ICE_ROUND2 (ks, n + 4, l, r); ICE_ROUND2 (ks, n + 6, l, r)
+
+
+/*
+ * Encrypt a block with a key of any number of rounds.
+ */
+
+static void
+ice_encrypt_generic (
+	const ICE_KEY		*ik,
+	const unsigned char	*ptext,
+	unsigned char		*ctext
+) {
+	const ICE_SUBKEY	*ks = ik->ik_keysched;
+	int			i;
+	uint32_t		l, r;
+
+	ICE_LOAD (ptext, l, r);
+
+	for (i = 0; i < ik->ik_rounds; i += 8) {
+	    ICE_ROUND8 (ks, i, l, r);
+	}
+
+	ICE_STORE (ctext, l, r);
+}
+
+
+/*
+ * Encrypt a block with a key of a fixed number of rounds,
+ * with the rounds fully unrolled.
+ */
+
+#define ICE_ENCRYPT_ROUNDS(name, body)	\
+static void \
+name ( \
+	const ICE_KEY		*ik, \
+	const unsigned char	*ptext, \
+	unsigned char		*ctext \
+) { \
+	const ICE_SUBKEY	*ks = ik->ik_keysched; \
+	uint32_t		l, r; \
+\
+	ICE_LOAD (ptext, l, r); \
+	body; \
+	ICE_STORE (ctext, l, r); \
+}
+
+ICE_ENCRYPT_ROUNDS (ice_encrypt_8,
+	ICE_ROUND8 (ks, 0, l, r))
+
+ICE_ENCRYPT_ROUNDS (ice_encrypt_16,
+	ICE_ROUND8 (ks, 0, l, r); ICE_ROUND8 (ks, 8, l, r))
+
+ICE_ENCRYPT_ROUNDS (ice_encrypt_32,
+	ICE_ROUND8 (ks, 0, l, r); ICE_ROUND8 (ks, 8, l, r);
+	ICE_ROUND8 (ks, 16, l, r); ICE_ROUND8 (ks, 24, l, r))
+
+
 /*
  * Encrypt a block of 8 bytes of data with the given ICE key.
+ * The round function was chosen when the key was created.
  */
 
 void
@@ -266,29 +255,158 @@ ice_key_encrypt (
 	const unsigned char	*ptext,
 	unsigned char		*ctext
 ) {
-	register int		i;
-	register unsigned long	l, r;
+	ik->ik_encrypt (ik, ptext, ctext);
+}
+
+
+/*
+ * Encrypt four blocks at once, interleaving their rounds so that
+ * the table lookups of each can overlap.
+ */
+
+static void
+ice_encrypt_x4 (
+	const ICE_KEY		*ik,
+	const unsigned char	*ptext,
+	unsigned char		*ctext
+) {
+	const ICE_SUBKEY	*ks = ik->ik_keysched;
+	int			i;
+	uint32_t		l0, l1, l2, l3, r0, r1, r2, r3;
 
-	l = (((unsigned long) ptext[0]) << 24)
-				| (((unsigned long) ptext[1]) << 16)
-				| (((unsigned long) ptext[2]) << 8) | ptext[3];
-	r = (((unsigned long) ptext[4]) << 24)
-				| (((unsigned long) ptext[5]) << 16)
-				| (((unsigned long) ptext[6]) << 8) | ptext[7];
+	ICE_LOAD (ptext, l0, r0);
+	ICE_LOAD ((ptext + 8), l1, r1);
+	ICE_LOAD ((ptext + 16), l2, r2);
+	ICE_LOAD ((ptext + 24), l3, r3);
 
 	for (i = 0; i < ik->ik_rounds; i += 2) {
-	    l ^= ice_f (r, ik->ik_keysched[i]);
-	    r ^= ice_f (l, ik->ik_keysched[i + 1]);
+	    l0 ^= ice_f (r0, ks[i]);
+	    l1 ^= ice_f (r1, ks[i]);
+	    l2 ^= ice_f (r2, ks[i]);
+	    l3 ^= ice_f (r3, ks[i]);
+
+	    r0 ^= ice_f (l0, ks[i + 1]);
+	    r1 ^= ice_f (l1, ks[i + 1]);
+	    r2 ^= ice_f (l2, ks[i + 1]);
+	    r3 ^= ice_f (l3, ks[i + 1]);
+	}
+
+	ICE_STORE (ctext, l0, r0);
+	ICE_STORE ((ctext + 8), l1, r1);
+	ICE_STORE ((ctext + 16), l2, r2);
+	ICE_STORE ((ctext + 24), l3, r3);
+}
+
+
+#ifdef ICE_HAVE_AVX2
+/*
+ * Encrypt eight blocks at once with AVX2, one block per 32-bit lane,
+ * using gathers for the S-box lookups.
+ */
+
+__attribute__ ((target ("avx2")))
+static void
+ice_encrypt_x8_avx2 (
+	const ICE_KEY		*ik,
+	const unsigned char	*ptext,
+	unsigned char		*ctext
+) {
+	const ICE_SUBKEY	*ks = ik->ik_keysched;
+	const __m256i		m10 = _mm256_set1_epi32 (0x3ff);
+	const __m256i		m20 = _mm256_set1_epi32 (0xffc00);
+	uint32_t		lw[8], rw[8];
+	__m256i			l, r;
+	int			i;
+
+	for (i=0; i<8; i++) {
+	    const unsigned char	*pt = ptext + i * 8;
+
+	    ICE_LOAD (pt, lw[i], rw[i]);
+	}
+
+	l = _mm256_loadu_si256 ((const __m256i *) lw);
+	r = _mm256_loadu_si256 ((const __m256i *) rw);
+
+	for (i = 0; i < ik->ik_rounds; i++) {
+	    __m256i	p = (i & 1) ? l : r;
+	    __m256i	tl, tr, al, ar, f;
+
+	    tl = _mm256_or_si256 (
+		    _mm256_and_si256 (_mm256_srli_epi32 (p, 16), m10),
+		    _mm256_and_si256 (_mm256_or_si256 (
+			_mm256_srli_epi32 (p, 14), _mm256_slli_epi32 (p, 18)),
+			m20));
+	    tr = _mm256_or_si256 (_mm256_and_si256 (p, m10),
+		    _mm256_and_si256 (_mm256_slli_epi32 (p, 2), m20));
+
+	    al = _mm256_and_si256 (_mm256_set1_epi32 (ks[i][2]),
+					_mm256_xor_si256 (tl, tr));
+	    ar = _mm256_xor_si256 (al, tr);
+	    al = _mm256_xor_si256 (al, tl);
+
+	    al = _mm256_xor_si256 (al, _mm256_set1_epi32 (ks[i][0]));
+	    ar = _mm256_xor_si256 (ar, _mm256_set1_epi32 (ks[i][1]));
+
+	    f = _mm256_or_si256 (
+		_mm256_or_si256 (
+		    _mm256_i32gather_epi32 ((const int *) ice_sbox[0],
+					_mm256_srli_epi32 (al, 10), 4),
+		    _mm256_i32gather_epi32 ((const int *) ice_sbox[1],
+					_mm256_and_si256 (al, m10), 4)),
+		_mm256_or_si256 (
+		    _mm256_i32gather_epi32 ((const int *) ice_sbox[2],
+					_mm256_srli_epi32 (ar, 10), 4),
+		    _mm256_i32gather_epi32 ((const int *) ice_sbox[3],
+					_mm256_and_si256 (ar, m10), 4)));
+
+	    if (i & 1)
+		r = _mm256_xor_si256 (r, f);
+	    else
+		l = _mm256_xor_si256 (l, f);
 	}
 
-	for (i = 0; i < 4; i++) {
-	    ctext[3 - i] = r & 0xff;
-	    ctext[7 - i] = l & 0xff;
+	_mm256_storeu_si256 ((__m256i *) lw, l);
+	_mm256_storeu_si256 ((__m256i *) rw, r);
+
+	for (i=0; i<8; i++) {
+	    unsigned char	*ct = ctext + i * 8;
 
-	    r >>= 8;
-	    l >>= 8;
+	    ICE_STORE (ct, lw[i], rw[i]);
 	}
 }
+#endif
+
+
+/*
+ * Encrypt n consecutive 8-byte blocks with the given ICE key.
+ * The blocks are independent, so several are encrypted at once,
+ * eight at a time with AVX2 if the CPU has it, otherwise four.
+ * The CPU's features are found by the runtime before main() is called,
+ * so they are checked each time rather than remembered, which keeps
+ * this safe to call from several threads.
+ */
+
+void
+ice_key_encrypt_many (
+	const ICE_KEY		*ik,
+	const unsigned char	*ptext,
+	unsigned char		*ctext,
+	int			n
+) {
+	int			i = 0;
+
+#ifdef ICE_HAVE_AVX2
+	if (__builtin_cpu_supports ("avx2"))
+	    for (; i + 8 <= n; i += 8)
+		ice_encrypt_x8_avx2 (ik, ptext + i * 8, ctext + i * 8);
+#endif
+
+	for (; i + 4 <= n; i += 4)
+	    ice_encrypt_x4 (ik, ptext + i * 8, ctext + i * 8);
+
+	for (; i < n; i++)
+	    ik->ik_encrypt (ik, ptext + i * 8, ctext + i * 8);
+}
 
 
 /*
@@ -301,33 +419,48 @@ ice_key_decrypt (
 	const unsigned char	*ctext,
 	unsigned char		*ptext
 ) {
-	register int		i;
-	register unsigned long	l, r;
+	int			i;
+	uint32_t		l, r;
 
-	l = (((unsigned long) ctext[0]) << 24)
-				| (((unsigned long) ctext[1]) << 16)
-				| (((unsigned long) ctext[2]) << 8) | ctext[3];
-	r = (((unsigned long) ctext[4]) << 24)
-				| (((unsigned long) ctext[5]) << 16)
-				| (((unsigned long) ctext[6]) << 8) | ctext[7];
+	ICE_LOAD (ctext, l, r);
 
 	for (i = ik->ik_rounds - 1; i > 0; i -= 2) {
 	    l ^= ice_f (r, ik->ik_keysched[i]);
 	    r ^= ice_f (l, ik->ik_keysched[i - 1]);
 	}
 
-	for (i = 0; i < 4; i++) {
-	    ptext[3 - i] = r & 0xff;
-	    ptext[7 - i] = l & 0xff;
+	ICE_STORE (ptext, l, r);
+}
 
-	    r >>= 8;
-	    l >>= 8;
-	}
+
+/*
+ * Spread the bits of a 16-bit value out to every fourth bit of a
+ * 64-bit value.
+ */
+
+static unsigned long long
+ice_spread16 (
+	unsigned long long	x
+) {
+	x &= 0xffff;
+	x = (x | (x << 24)) & 0x000000ff000000ffULL;
+	x = (x | (x << 12)) & 0x000f000f000f000fULL;
+	x = (x | (x << 6)) & 0x0303030303030303ULL;
+	x = (x | (x << 3)) & 0x1111111111111111ULL;
+
+	return (x);
 }
 
 
 /*
  * Set 8 rounds [n, n+7] of the key schedule of an ICE key.
+ *
+ * Each round takes the bottom 15 bits of the four key words, one bit
+ * from each word in turn, giving 15 four-bit nibbles which are dealt
+ * out to the three subkeys. Rather than shifting one bit at a time,
+ * the four words are interleaved so that nibble j holds bit j of each
+ * word. Each word is then rotated right 15 bits, with the bits rotated
+ * out being complemented.
  */
 
 static void
@@ -343,22 +476,22 @@ ice_key_sched_build (
 	    register int	j;
 	    register int	kr = keyrot[i];
 	    ICE_SUBKEY		*isk = &ik->ik_keysched[n + i];
+	    unsigned long long	nib;
 
-	    for (j=0; j<3; j++)
-		(*isk)[j] = 0;
-
-	    for (j=0; j<15; j++) {
-		register int	k;
-		unsigned long	*curr_sk = &(*isk)[j % 3];
+	    nib = (ice_spread16 (kb[kr & 3]) << 3)
+				| (ice_spread16 (kb[(kr + 1) & 3]) << 2)
+				| (ice_spread16 (kb[(kr + 2) & 3]) << 1)
+				| ice_spread16 (kb[(kr + 3) & 3]);
 
-		for (k=0; k<4; k++) {
-		    unsigned short	*curr_kb = &kb[(kr + k) & 3];
-		    register int	bit = *curr_kb & 1;
+	    for (j=0; j<3; j++)
+		(*isk)[j] = (((nib >> (j * 4)) & 0xf) << 16)
+				| (((nib >> (j * 4 + 12)) & 0xf) << 12)
+				| (((nib >> (j * 4 + 24)) & 0xf) << 8)
+				| (((nib >> (j * 4 + 36)) & 0xf) << 4)
+				| ((nib >> (j * 4 + 48)) & 0xf);
 
-		    *curr_sk = (*curr_sk << 1) | bit;
-		    *curr_kb = (*curr_kb >> 1) | ((bit ^ 1) << 15);
-		}
-	    }
+	    for (j=0; j<4; j++)
+		kb[j] = (kb[j] >> 15) | ((~kb[j] & 0x7fff) << 1);
 	}
 }
 
@@ -20,6 +20,9 @@ extern void	ice_key_destroy P_((ICE_KEY *ik));
 extern void	ice_key_set P_((ICE_KEY *ik, const unsigned char *k));
 extern void	ice_key_encrypt P_((const ICE_KEY *ik,
 			const unsigned char *ptxt, unsigned char *ctxt));
+extern void	ice_key_encrypt_many P_((const ICE_KEY *ik,
+			const unsigned char *ptxt, unsigned char *ctxt,
+			int n));
 extern void	ice_key_decrypt P_((const ICE_KEY *ik,
 			const unsigned char *ctxt, unsigned char *ptxt));
 
@@ -0,0 +1,376 @@
+/*
+ * Key ring extraction for the gifshuffle steganography program.
+ * Finds which of a list of passwords opens each of a list of carriers,
+ * by checking the payload header of every carrier under every key.
+ * The (carrier, key) pairs are shared out between a pool of threads.
+ * Since the header's tag is short, each match is then confirmed by
+ * decoding the whole message, and if that fails the search carries on
+ * with the keys after it.
+ */
+
+#include "gifshuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (unix) || defined (__unix__)
+#define KEYRING_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+
+/*
+ * The most passwords a key ring may hold, and the most threads used.
+ */
+
+#define KEYRING_MAX_KEYS	4096
+#define KEYRING_MAX_THREADS	64
+
+
+/*
+ * The state of a key ring search, shared between the threads.
+ * Each task is one (carrier, key) pair, numbered carrier by carrier.
+ */
+
+typedef struct {
+	const CONTEXT	*ks_ctx;
+	CARRIER		**ks_carriers;
+	int		ks_ncarriers;
+	PASSWORD_KEY	**ks_keys;
+	int		*ks_lines;	/* Line of the ring each key is on */
+	int		ks_nkeys;
+	int		ks_next_task;
+	int		*ks_first;	/* First key still to check */
+	int		*ks_match;	/* Lowest matching key, or -1 */
+#ifdef KEYRING_THREADS
+	pthread_mutex_t	ks_lock;
+#endif
+} KEYRING_SEARCH;
+
+
+/*
+ * Load the passwords from a key ring file, one per line, and build
+ * their keys, noting the line each is on. Blank lines are skipped, and
+ * lines too long for the buffer are rejected rather than split.
+ * Returns the number of keys, or -1 on error, in which case none
+ * are left built.
+ */
+
+static int
+keyring_load (
+	CONTEXT		*ctx,
+	const char	*path,
+	PASSWORD_KEY	**keys,
+	int		*lines
+) {
+	FILE		*fp;
+	char		line[2048];
+	int		nkeys = 0, lineno = 0;
+	BOOL		ok = TRUE;
+
+	if ((fp = fopen (path, "r")) == NULL) {
+	    perror (path);
+	    return (-1);
+	}
+
+	while (fgets (line, sizeof (line), fp) != NULL) {
+	    int		len = strlen (line);
+
+	    lineno++;
+	    if ((len == 0 || line[len - 1] != '\n') && !feof (fp)) {
+		fprintf (stderr, "%s: line %d is too long.\n", path, lineno);
+		ok = FALSE;
+		break;
+	    }
+
+	    while (len > 0 && (line[len - 1] == '\n'
+					|| line[len - 1] == '\r'))
+		line[--len] = '\0';
+
+	    if (len == 0)
+		continue;
+
+	    if (nkeys == KEYRING_MAX_KEYS) {
+		fprintf (stderr, "Key ring has more than %d passwords.\n",
+							KEYRING_MAX_KEYS);
+		break;
+	    }
+
+	    if ((keys[nkeys] = password_key_get (ctx, line)) == NULL) {
+		fprintf (stderr, "Could not build key on line %d.\n", lineno);
+		break;
+	    }
+	    lines[nkeys++] = lineno;
+	}
+
+	if (ferror (fp) != 0) {
+	    perror (path);
+	    ok = FALSE;
+	}
+
+	if (!ok) {
+	    while (nkeys > 0)
+		password_key_release (keys[--nkeys]);
+	    nkeys = -1;
+	}
+
+	fclose (fp);
+
+	return (nkeys);
+}
+
+
+/*
+ * Take the next task that still needs doing.
+ * Keys before a carrier's first key still to check, and later in the
+ * ring than a match already found, are skipped.
+ * Returns FALSE when there are no tasks left.
+ */
+
+static BOOL
+keyring_next_task (
+	KEYRING_SEARCH	*ks,
+	int		*carrier,
+	int		*key
+) {
+	BOOL		found = FALSE;
+
+#ifdef KEYRING_THREADS
+	pthread_mutex_lock (&ks->ks_lock);
+#endif
+	while (ks->ks_next_task < ks->ks_ncarriers * ks->ks_nkeys) {
+	    int		t = ks->ks_next_task++;
+	    int		c = t / ks->ks_nkeys, k = t % ks->ks_nkeys;
+
+	    if (k >= ks->ks_first[c]
+			&& (ks->ks_match[c] < 0 || k < ks->ks_match[c])) {
+		*carrier = c;
+		*key = k;
+		found = TRUE;
+		break;
+	    }
+	}
+#ifdef KEYRING_THREADS
+	pthread_mutex_unlock (&ks->ks_lock);
+#endif
+
+	return (found);
+}
+
+
+/*
+ * Work through the tasks of a key ring search.
+ */
+
+static void *
+keyring_worker (
+	void		*arg
+) {
+	KEYRING_SEARCH	*ks = (KEYRING_SEARCH *) arg;
+	int		c, k;
+
+	while (keyring_next_task (ks, &c, &k)) {
+	    if (carrier_key_check (ks->ks_ctx, ks->ks_carriers[c],
+							ks->ks_keys[k]) < 0)
+		continue;
+
+#ifdef KEYRING_THREADS
+	    pthread_mutex_lock (&ks->ks_lock);
+#endif
+	    if (ks->ks_match[c] < 0 || k < ks->ks_match[c])
+		ks->ks_match[c] = k;
+#ifdef KEYRING_THREADS
+	    pthread_mutex_unlock (&ks->ks_lock);
+#endif
+	}
+
+	return (NULL);
+}
+
+
+/*
+ * Run the tasks of a key ring search on a pool of threads, one per
+ * processor, or in this thread if threads aren't available.
+ */
+
+static void
+keyring_run (
+	KEYRING_SEARCH	*ks
+) {
+#ifdef KEYRING_THREADS
+	pthread_t	threads[KEYRING_MAX_THREADS];
+	long		nthreads = sysconf (_SC_NPROCESSORS_ONLN);
+	int		i, started = 0;
+
+	if (nthreads > KEYRING_MAX_THREADS)
+	    nthreads = KEYRING_MAX_THREADS;
+	if (nthreads > ks->ks_ncarriers * ks->ks_nkeys)
+	    nthreads = ks->ks_ncarriers * ks->ks_nkeys;
+
+	ks->ks_next_task = 0;
+	pthread_mutex_init (&ks->ks_lock, NULL);
+
+	for (i=0; i<nthreads; i++)
+	    if (pthread_create (&threads[started], NULL, keyring_worker,
+								ks) == 0)
+		started++;
+
+		/* Work in this thread too, which also covers the case
+		 * where no threads could be started.
+		 */
+	keyring_worker (ks);
+
+	for (i=0; i<started; i++)
+	    pthread_join (threads[i], NULL);
+
+	pthread_mutex_destroy (&ks->ks_lock);
+#else
+	ks->ks_next_task = 0;
+	keyring_worker (ks);
+#endif
+}
+
+
+/*
+ * Confirm the match found for each carrier still being searched.
+ * A carrier whose match fails is searched again from the key after it.
+ * Returns TRUE if any carriers need searching again.
+ */
+
+static BOOL
+keyring_confirm (
+	CONTEXT		*ctx,
+	KEYRING_SEARCH	*ks
+) {
+	BOOL		again = FALSE;
+	int		c;
+
+	for (c=0; c<ks->ks_ncarriers; c++) {
+	    int		k = ks->ks_match[c];
+
+	    if (ks->ks_first[c] == ks->ks_nkeys)
+		continue;
+
+	    if (k < 0 || carrier_key_confirm (ctx, ks->ks_carriers[c],
+							ks->ks_keys[k]))
+		ks->ks_first[c] = ks->ks_nkeys;
+	    else {
+		ks->ks_first[c] = k + 1;
+		ks->ks_match[c] = -1;
+		again = TRUE;
+	    }
+	}
+
+	return (again);
+}
+
+
+/*
+ * Find which key in a key ring opens each of a list of carrier files.
+ * Messages must have been concealed with a payload header.
+ * The line number of the first password in the ring that opens each
+ * file is reported, counting from 1.
+ * If no files are given, a carrier is read from standard input.
+ */
+
+BOOL
+keyring_extract (
+	CONTEXT		*ctx,
+	const char	*ring_path,
+	char		**files,
+	int		nfiles
+) {
+	static char	*stdin_name[] = {"-"};
+	KEYRING_SEARCH	ks;
+	BOOL		ok = FALSE;
+	int		i;
+
+	if (nfiles == 0) {
+	    files = stdin_name;
+	    nfiles = 1;
+	}
+
+	ks.ks_ctx = ctx;
+	ks.ks_ncarriers = nfiles;
+	ks.ks_nkeys = 0;
+	ks.ks_keys = (PASSWORD_KEY **) malloc (KEYRING_MAX_KEYS
+						* sizeof (PASSWORD_KEY *));
+	ks.ks_lines = (int *) malloc (KEYRING_MAX_KEYS * sizeof (int));
+	ks.ks_carriers = (CARRIER **) calloc (nfiles, sizeof (CARRIER *));
+	ks.ks_first = (int *) malloc (nfiles * sizeof (int));
+	ks.ks_match = (int *) malloc (nfiles * sizeof (int));
+
+	if (ks.ks_keys == NULL || ks.ks_lines == NULL || ks.ks_carriers == NULL
+			|| ks.ks_first == NULL || ks.ks_match == NULL) {
+	    fprintf (stderr, "Out of memory for key ring search.\n");
+	    goto cleanup;
+	}
+
+	if ((ks.ks_nkeys = keyring_load (ctx, ring_path, ks.ks_keys,
+							ks.ks_lines)) <= 0) {
+	    if (ks.ks_nkeys == 0)
+		fprintf (stderr, "Key ring %s is empty.\n", ring_path);
+	    ks.ks_nkeys = 0;
+	    goto cleanup;
+	}
+
+		/* Parse each carrier's colourmap just once */
+	ok = TRUE;
+	for (i=0; i<nfiles; i++) {
+	    FILE	*fp;
+
+	    ks.ks_first[i] = 0;
+	    ks.ks_match[i] = -1;
+
+	    if (strcmp (files[i], "-") == 0)
+		fp = stdin;
+	    else if ((fp = fopen (files[i], "rb")) == NULL) {
+		perror (files[i]);
+		ok = FALSE;
+		continue;
+	    }
+
+	    if ((ks.ks_carriers[i] = carrier_load (ctx, fp)) == NULL)
+		ok = FALSE;
+
+	    if (fp != stdin)
+		fclose (fp);
+	}
+
+		/* Unloadable carriers are not searched */
+	for (i=0; i<nfiles; i++)
+	    if (ks.ks_carriers[i] == NULL)
+		ks.ks_first[i] = ks.ks_nkeys;
+
+	do
+	    keyring_run (&ks);
+	while (keyring_confirm (ctx, &ks));
+
+	for (i=0; i<nfiles; i++) {
+	    if (ks.ks_carriers[i] == NULL)
+		continue;
+
+	    if (ks.ks_match[i] < 0)
+		printf ("%s: no matching key\n", files[i]);
+	    else
+		printf ("%s: key %d\n", files[i],
+					ks.ks_lines[ks.ks_match[i]]);
+	}
+
+cleanup:
+	if (ks.ks_carriers != NULL)
+	    for (i=0; i<nfiles; i++)
+		carrier_free (ks.ks_carriers[i]);
+
+	for (i=0; i<ks.ks_nkeys; i++)
+	    password_key_release (ks.ks_keys[i]);
+
+	free (ks.ks_match);
+	free (ks.ks_first);
+	free (ks.ks_carriers);
+	free (ks.ks_lines);
+	free (ks.ks_keys);
+
+	return (ok);
+}
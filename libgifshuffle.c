@@ -0,0 +1,400 @@
+/*
+ * Library interface to the gifshuffle steganography program.
+ * The buffers passed in are opened as streams, and run through the
+ * same routines as the command-line program, with the output being
+ * collected in a buffer that grows as needed.
+ * A handle wraps a context, so that its caches are kept from one call
+ * to the next. The one-off calls open a handle of their own, so they
+ * can be made from several threads at once.
+ */
+
+#include "gifshuf.h"
+#include "gifshuffle.h"
+
+#include <stdlib.h>
+
+
+/*
+ * A handle, holding the context that its calls are run in.
+ */
+
+struct gifshuffle_struct {
+	CONTEXT		*gs_ctx;
+};
+
+
+/*
+ * Create a context with a set of options, or the defaults if there are
+ * none. Warnings are turned off.
+ * Returns NULL if an option is not valid, or memory runs out.
+ */
+
+static CONTEXT *
+options_context (
+	const GIFSHUFFLE_OPTIONS	*opts
+) {
+	CONTEXT				*ctx;
+
+	if ((ctx = context_create ()) == NULL)
+	    return (NULL);
+
+	ctx->ctx_quiet_flag = TRUE;
+
+	if (opts == NULL)
+	    return (ctx);
+
+	ctx->ctx_compress_flag = (opts->gso_compress != 0);
+	ctx->ctx_v1_flag = (opts->gso_v1 != 0);
+	ctx->ctx_group_flag = (opts->gso_group != 0);
+	ctx->ctx_block_flag = (opts->gso_block != 0);
+	ctx->ctx_fixed_key_flag = (opts->gso_fixed_key != 0);
+	ctx->ctx_header_flag = (opts->gso_header != 0);
+
+	if (opts->gso_table != NULL) {
+	    if ((ctx->ctx_compress_table = huff_table_find (opts->gso_table))
+									< 0) {
+		fprintf (stderr, "Unknown compression table '%s'\n",
+							opts->gso_table);
+		context_destroy (ctx);
+		return (NULL);
+	    }
+	    ctx->ctx_compress_flag = TRUE;
+	}
+
+	if (opts->gso_method != NULL) {
+	    if ((ctx->ctx_compress_method
+			= compress_method_find (opts->gso_method)) < 0) {
+		fprintf (stderr, "Unknown compression method '%s'\n",
+							opts->gso_method);
+		context_destroy (ctx);
+		return (NULL);
+	    }
+	    ctx->ctx_compress_flag = TRUE;
+	}
+
+	if (opts->gso_dict != NULL) {
+	    if ((ctx->ctx_compress_dict = dict_find (ctx, opts->gso_dict))
+									< 0) {
+		context_destroy (ctx);
+		return (NULL);
+	    }
+	    if (ctx->ctx_compress_method != METHOD_AUTO)
+		ctx->ctx_compress_method = METHOD_DICT;
+	    ctx->ctx_compress_flag = TRUE;
+	}
+
+	if (opts->gso_password != NULL)
+	    password_set (ctx, opts->gso_password);
+
+	return (ctx);
+}
+
+
+/*
+ * Open a carrier buffer as a stream.
+ * Returns NULL on error.
+ */
+
+static FILE *
+carrier_open (
+	const unsigned char	*carrier,
+	size_t			carrier_len
+) {
+	FILE			*fp;
+
+	if (carrier_len == 0) {
+	    fprintf (stderr, "Input file is not in GIF format.\n");
+	    return (NULL);
+	}
+
+	if ((fp = fmemopen ((void *) carrier, carrier_len, "rb")) == NULL)
+	    perror ("Carrier buffer");
+
+	return (fp);
+}
+
+
+/*
+ * Close an output stream opened on the buffer and size given, and
+ * hand over the buffer if all went well, freeing it otherwise.
+ */
+
+static BOOL
+output_close (
+	FILE		*outf,
+	char		**buf,
+	size_t		*size,
+	BOOL		ok,
+	unsigned char	**out,
+	size_t		*out_len
+) {
+	if (fclose (outf) != 0) {
+	    perror ("Output buffer");
+	    ok = FALSE;
+	}
+
+	if (!ok) {
+	    free (*buf);
+	    return (FALSE);
+	}
+
+	*out = (unsigned char *) *buf;
+	*out_len = *size;
+
+	return (TRUE);
+}
+
+
+/*
+ * Open a handle for a set of options.
+ * Returns NULL if an option is not valid, or memory runs out.
+ */
+
+GIFSHUFFLE *
+gifshuffle_open (
+	const GIFSHUFFLE_OPTIONS	*opts
+) {
+	GIFSHUFFLE			*gs;
+
+	if ((gs = (GIFSHUFFLE *) malloc (sizeof (GIFSHUFFLE))) == NULL) {
+	    fprintf (stderr, "Out of memory for handle.\n");
+	    return (NULL);
+	}
+
+	if ((gs->gs_ctx = options_context (opts)) == NULL) {
+	    free (gs);
+	    return (NULL);
+	}
+
+	return (gs);
+}
+
+
+/*
+ * Close a handle. A NULL handle is ignored.
+ */
+
+void
+gifshuffle_close (
+	GIFSHUFFLE	*gs
+) {
+	if (gs == NULL)
+	    return;
+
+	context_destroy (gs->gs_ctx);
+	free (gs);
+}
+
+
+/*
+ * Hide a message in a carrier with a handle's options, giving the new
+ * GIF in a buffer.
+ */
+
+int
+gifshuffle_embed_with (
+	GIFSHUFFLE		*gs,
+	const unsigned char	*carrier,
+	size_t			carrier_len,
+	const unsigned char	*msg,
+	size_t			msg_len,
+	unsigned char		**out,
+	size_t			*out_len
+) {
+	CONTEXT			*ctx = gs->gs_ctx;
+	FILE			*inf, *outf;
+	char			*buf = NULL;
+	size_t			size = 0;
+	BOOL			ok = TRUE;
+
+	*out = NULL;
+	*out_len = 0;
+
+	if (ctx->ctx_compress_flag && ctx->ctx_compress_method == METHOD_DICT
+					&& ctx->ctx_compress_dict < 0) {
+	    fprintf (stderr, "The dict method needs a dictionary\n");
+	    return (FALSE);
+	}
+
+	if ((inf = carrier_open (carrier, carrier_len)) == NULL)
+	    return (FALSE);
+
+	if ((outf = open_memstream (&buf, &size)) == NULL) {
+	    perror ("Output buffer");
+	    fclose (inf);
+	    return (FALSE);
+	}
+
+	compress_init (ctx);
+
+	while (ok && msg_len > 0) {
+	    int		n = (msg_len < 4096) ? msg_len : 4096;
+
+	    ok = compress_bytes (ctx, msg, n, inf, outf);
+	    msg += n;
+	    msg_len -= n;
+	}
+
+	if (ok)
+	    ok = compress_flush (ctx, inf, outf);
+
+	fclose (inf);
+
+	return (output_close (outf, &buf, &size, ok, out, out_len));
+}
+
+
+/*
+ * Extract a message from a carrier with a handle's options, into
+ * a buffer.
+ */
+
+int
+gifshuffle_extract_with (
+	GIFSHUFFLE		*gs,
+	const unsigned char	*carrier,
+	size_t			carrier_len,
+	unsigned char		**msg,
+	size_t			*msg_len
+) {
+	FILE			*inf, *outf;
+	char			*buf = NULL;
+	size_t			size = 0;
+	BOOL			ok;
+
+	*msg = NULL;
+	*msg_len = 0;
+
+	if ((inf = carrier_open (carrier, carrier_len)) == NULL)
+	    return (FALSE);
+
+	if ((outf = open_memstream (&buf, &size)) == NULL) {
+	    perror ("Output buffer");
+	    fclose (inf);
+	    return (FALSE);
+	}
+
+	ok = message_extract (gs->gs_ctx, inf, outf);
+	fclose (inf);
+
+	return (output_close (outf, &buf, &size, ok, msg, msg_len));
+}
+
+
+/*
+ * Return the number of message bits a carrier can hold with a
+ * handle's options, or -1 on error.
+ */
+
+long
+gifshuffle_capacity_with (
+	GIFSHUFFLE		*gs,
+	const unsigned char	*carrier,
+	size_t			carrier_len
+) {
+	FILE			*inf;
+	int			bits;
+
+	if ((inf = carrier_open (carrier, carrier_len)) == NULL)
+	    return (-1);
+
+	bits = message_capacity (gs->gs_ctx, inf, NULL, NULL);
+	fclose (inf);
+
+	return (bits);
+}
+
+
+/*
+ * Hide a message in a carrier, giving the new GIF in a buffer.
+ */
+
+int
+gifshuffle_embed (
+	const unsigned char		*carrier,
+	size_t				carrier_len,
+	const unsigned char		*msg,
+	size_t				msg_len,
+	const GIFSHUFFLE_OPTIONS	*opts,
+	unsigned char			**out,
+	size_t				*out_len
+) {
+	GIFSHUFFLE			*gs;
+	int				ok;
+
+	*out = NULL;
+	*out_len = 0;
+
+	if ((gs = gifshuffle_open (opts)) == NULL)
+	    return (FALSE);
+
+	ok = gifshuffle_embed_with (gs, carrier, carrier_len, msg, msg_len,
+							out, out_len);
+	gifshuffle_close (gs);
+
+	return (ok);
+}
+
+
+/*
+ * Extract a message from a carrier into a buffer.
+ */
+
+int
+gifshuffle_extract (
+	const unsigned char		*carrier,
+	size_t				carrier_len,
+	const GIFSHUFFLE_OPTIONS	*opts,
+	unsigned char			**msg,
+	size_t				*msg_len
+) {
+	GIFSHUFFLE			*gs;
+	int				ok;
+
+	*msg = NULL;
+	*msg_len = 0;
+
+	if ((gs = gifshuffle_open (opts)) == NULL)
+	    return (FALSE);
+
+	ok = gifshuffle_extract_with (gs, carrier, carrier_len, msg, msg_len);
+	gifshuffle_close (gs);
+
+	return (ok);
+}
+
+
+/*
+ * Return the number of message bits a carrier can hold with the
+ * given options, or -1 on error.
+ */
+
+long
+gifshuffle_capacity (
+	const unsigned char		*carrier,
+	size_t				carrier_len,
+	const GIFSHUFFLE_OPTIONS	*opts
+) {
+	GIFSHUFFLE			*gs;
+	long				bits;
+
+	if ((gs = gifshuffle_open (opts)) == NULL)
+	    return (-1);
+
+	bits = gifshuffle_capacity_with (gs, carrier, carrier_len);
+	gifshuffle_close (gs);
+
+	return (bits);
+}
+
+
+/*
+ * Free a buffer returned by the library.
+ */
+
+void
+gifshuffle_free (
+	void		*buf
+) {
+	free (buf);
+}
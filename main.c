@@ -2,14 +2,25 @@
  * Command-line program for hiding and extracting messages within
  * the colourmap of GIF images.
  *
- * Usage: gifshuffle [-C][-Q][-S][-1][-p passwd] [-f file | -m message]
- *					[infile [outfile]]
+ * Usage: gifshuffle [-C][-Q][-S][-1][-G][-B][-K][-H][-M method][-T table]
+ *			[-D dict][-p passwd][-P cache]
+ *				[-f file | -m message] [infile [outfile]]
+ *        gifshuffle [-Q][-1][-G][-B][-K] -R keyring [infile ...]
  *
  *	-C : Use compression
  *	-Q : Be quiet
  *	-S : Calculate the space available in the file
  *	-1 : Use the old Gifshuffle 1.0 concealment algorithm
+ *	-G : Use grouped permutation coding
+ *	-B : Encrypt in 64-bit blocks rather than bit by bit
+ *	-K : Derive a fixed-size key from the password
+ *	-H : Precede the message with a checked payload header
+ *	-M : Compress with the named method, huffman, range, cm, dict or auto
+ *	-T : Compress with the named Huffman table
+ *	-D : Compress with the named preset dictionary, or dictionary file
  *	-p : Specify the password to encrypt the message
+ *	-P : Use the specified palette cache file
+ *	-R : Find which password in the key ring opens each file
  *
  *	-f : Insert the message contained in the file
  *	-m : Insert the message given
@@ -17,43 +28,16 @@
  * If the program is executed without either of the -f or -m options
  * then the program will attempt to extract a concealed message.
  * The output will go to outfile if specified, stdout otherwise.
+ * With -R, every file named is checked against every password in the
+ * key ring, and the number of the matching password is reported.
  *
  * Written by Matthew Kwan - January 1998
  */
 
 #include "gifshuf.h"
+#include "pcache.h"
 
-
-/*
- * Declaration of global variables.
- */
-
-BOOL	compress_flag = FALSE;
-BOOL	quiet_flag = FALSE;
-BOOL	v1_flag = FALSE;
-
-
-/*
- * Encode a single character.
- */
-
-static BOOL
-character_encode (
-	unsigned char	c,
-	FILE		*infile,
-	FILE		*outfile
-) {
-	int		i;
-
-	for (i=0; i<8; i++) {
-	    int		bit = ((c & (128 >> i)) != 0) ? 1 : 0;
-
-	    if (!compress_bit (bit, infile, outfile))
-		return (FALSE);
-	}
-
-	return (TRUE);
-}
+#include <string.h>
 
 
 /*
@@ -62,19 +46,18 @@ character_encode (
 
 static BOOL
 message_string_encode (
+	CONTEXT		*ctx,
 	const char	*msg,
 	FILE		*infile,
 	FILE		*outfile
 ) {
-	compress_init ();
+	compress_init (ctx);
 
-	while (*msg != '\0') {
-	    if (!character_encode (*msg, infile, outfile))
-		return (FALSE);
-	    msg++;
-	}
+	if (!compress_bytes (ctx, (const unsigned char *) msg, strlen (msg),
+							infile, outfile))
+	    return (FALSE);
 
-	return (compress_flush (infile, outfile));
+	return (compress_flush (ctx, infile, outfile));
 }
 
 
@@ -84,16 +67,18 @@ message_string_encode (
 
 static BOOL
 message_fp_encode (
+	CONTEXT		*ctx,
 	FILE		*msg_fp,
 	FILE		*infile,
 	FILE		*outfile
 ) {
-	int		c;
+	unsigned char	buf[4096];
+	size_t		n;
 
-	compress_init ();
+	compress_init (ctx);
 
-	while ((c = fgetc (msg_fp)) != EOF)
-	    if (!character_encode (c, infile, outfile))
+	while ((n = fread (buf, 1, sizeof (buf), msg_fp)) > 0)
+	    if (!compress_bytes (ctx, buf, n, infile, outfile))
 		return (FALSE);
 
 	if (ferror (msg_fp) != 0) {
@@ -101,7 +86,7 @@ message_fp_encode (
 	    return (FALSE);
 	}
 
-	return (compress_flush (infile, outfile));
+	return (compress_flush (ctx, infile, outfile));
 }
 
 
@@ -118,11 +103,18 @@ main (
 	int		optind;
 	BOOL		errflag = FALSE;
 	BOOL		space_flag = FALSE;
+	BOOL		ok = FALSE;
 	char		*passwd = NULL;
+	char		*cache_path = NULL;
+	char		*ring_path = NULL;
 	char		*message_string = NULL;
 	FILE		*message_fp = NULL;
 	FILE		*infile = stdin;
 	FILE		*outfile = stdout;
+	CONTEXT		*ctx;
+
+	if ((ctx = context_create ()) == NULL)
+	    return (1);
 
 	optind = 1;
 	for (optind = 1; optind < argc
@@ -137,16 +129,28 @@ main (
 
 	    switch (c) {
 		case 'C':
-		    compress_flag = TRUE;
+		    ctx->ctx_compress_flag = TRUE;
 		    break;
 		case 'Q':
-		    quiet_flag = TRUE;
+		    ctx->ctx_quiet_flag = TRUE;
 		    break;
 		case 'S':
 		    space_flag = TRUE;
 		    break;
 		case '1':
-		    v1_flag = TRUE;
+		    ctx->ctx_v1_flag = TRUE;
+		    break;
+		case 'G':
+		    ctx->ctx_group_flag = TRUE;
+		    break;
+		case 'B':
+		    ctx->ctx_block_flag = TRUE;
+		    break;
+		case 'K':
+		    ctx->ctx_fixed_key_flag = TRUE;
+		    break;
+		case 'H':
+		    ctx->ctx_header_flag = TRUE;
 		    break;
 		case 'f':
 		    if (argv[optind][2] != '\0')
@@ -184,6 +188,83 @@ main (
 
 		    passwd = optarg;
 		    break;
+		case 'P':
+		    if (argv[optind][2] != '\0')
+			optarg = &argv[optind][2];
+		    else if (++optind == argc) {
+			errflag = TRUE;
+			break;
+		    } else
+			optarg = argv[optind];
+
+		    cache_path = optarg;
+		    break;
+		case 'M':
+		    if (argv[optind][2] != '\0')
+			optarg = &argv[optind][2];
+		    else if (++optind == argc) {
+			errflag = TRUE;
+			break;
+		    } else
+			optarg = argv[optind];
+
+		    if ((ctx->ctx_compress_method
+				= compress_method_find (optarg)) < 0) {
+			fprintf (stderr, "Unknown compression method '%s'\n",
+								optarg);
+			errflag = TRUE;
+		    }
+		    ctx->ctx_compress_flag = TRUE;
+		    break;
+		case 'D':
+		    if (argv[optind][2] != '\0')
+			optarg = &argv[optind][2];
+		    else if (++optind == argc) {
+			errflag = TRUE;
+			break;
+		    } else
+			optarg = argv[optind];
+
+		    if ((ctx->ctx_compress_dict = dict_find (ctx, optarg)) < 0)
+			errflag = TRUE;
+		    if (ctx->ctx_compress_method != METHOD_AUTO)
+			ctx->ctx_compress_method = METHOD_DICT;
+		    ctx->ctx_compress_flag = TRUE;
+		    break;
+		case 'T':
+		    if (argv[optind][2] != '\0')
+			optarg = &argv[optind][2];
+		    else if (++optind == argc) {
+			errflag = TRUE;
+			break;
+		    } else
+			optarg = argv[optind];
+
+		    if ((ctx->ctx_compress_table = huff_table_find (optarg))
+									< 0) {
+			int	i;
+
+			fprintf (stderr, "Unknown compression table '%s' - %s",
+						optarg, "choose from");
+			for (i=0; i<HUFF_TABLES; i++)
+			    fprintf (stderr, " %s", huff_table_name (i));
+			fprintf (stderr, "\n");
+			errflag = TRUE;
+		    }
+		    ctx->ctx_compress_method = METHOD_HUFFMAN;
+		    ctx->ctx_compress_flag = TRUE;
+		    break;
+		case 'R':
+		    if (argv[optind][2] != '\0')
+			optarg = &argv[optind][2];
+		    else if (++optind == argc) {
+			errflag = TRUE;
+			break;
+		    } else
+			optarg = argv[optind];
+
+		    ring_path = optarg;
+		    break;
 		default:
 		    fprintf (stderr, "Illegal option '%s'\n", argv[optind]);
 		    errflag = TRUE;
@@ -199,48 +280,79 @@ main (
 	    errflag = TRUE;
 	}
 
-	if (errflag || optind < argc - 2) {
-	    fprintf (stderr, "Usage: %s [-C][-Q][-S][-1] ", argv[0]);
-	    fprintf (stderr, "[-p passwd] [-f file | -m message]\n");
-	    fprintf (stderr, "\t\t\t\t\t[infile [outfile]]\n");
-	    return (1);
+	if (ctx->ctx_compress_flag && ctx->ctx_compress_method == METHOD_DICT
+			&& ctx->ctx_compress_dict < 0 && (message_string != NULL
+						|| message_fp != NULL)) {
+	    fprintf (stderr, "The dict method needs a dictionary (-D)\n");
+	    errflag = TRUE;
+	}
+
+	if (ring_path != NULL && (message_string != NULL
+			|| message_fp != NULL || space_flag || passwd != NULL)) {
+	    fprintf (stderr, "A key ring can only be used for extraction\n");
+	    errflag = TRUE;
+	}
+
+	if (errflag || (ring_path == NULL && optind < argc - 2)) {
+	    fprintf (stderr, "Usage: %s [-C][-Q][-S][-1][-G][-B][-K][-H] ",
+								argv[0]);
+	    fprintf (stderr, "[-M method] [-T table] [-D dict]\n");
+	    fprintf (stderr, "\t\t\t[-p passwd] [-P cache] ");
+	    fprintf (stderr, "[-f file | -m message] [infile [outfile]]\n");
+	    fprintf (stderr, "       %s [-Q][-1][-G][-B][-K] ", argv[0]);
+	    fprintf (stderr, "-R keyring [infile ...]\n");
+	    goto cleanup;
 	}
 
 	if (passwd != NULL)
-	    password_set (passwd);
+	    password_set (ctx, passwd);
+
+	if (cache_path != NULL
+		&& (ctx->ctx_pcache = pcache_open (cache_path)) == NULL
+						&& !ctx->ctx_quiet_flag)
+	    fprintf (stderr, "Warning: not using palette cache\n");
+
+	if (ring_path != NULL) {
+	    ctx->ctx_header_flag = TRUE;
+	    ok = keyring_extract (ctx, ring_path, &argv[optind],
+							argc - optind);
+	    goto cleanup;
+	}
 
 	if (optind < argc) {
 	    if ((infile = fopen (argv[optind], "rb")) == NULL) {
 		perror (argv[optind]);
-		return (1);
+		goto cleanup;
 	    }
 	}
 
 	if (optind + 1 < argc) {
 	    if ((outfile = fopen (argv[optind + 1], "wb")) == NULL) {
 		perror (argv[optind + 1]);
-		return (1);
+		goto cleanup;
 	    }
 	}
 
 	if (space_flag) {
-	    space_calculate (infile);
-	} else if (message_string != NULL) {
-	    if (!message_string_encode (message_string, infile, outfile))
-		return (1);
-	} else if (message_fp != NULL) {
-	    if (!message_fp_encode (message_fp, infile, outfile))
-		return (1);
+	    space_calculate (ctx, infile);
+	    ok = TRUE;
+	} else if (message_string != NULL)
+	    ok = message_string_encode (ctx, message_string, infile, outfile);
+	else if (message_fp != NULL)
+	    ok = message_fp_encode (ctx, message_fp, infile, outfile);
+	else
+	    ok = message_extract (ctx, infile, outfile);
+
+		/* Every exit after the context is created comes through here */
+cleanup:
+	context_destroy (ctx);
+
+	if (message_fp != NULL)
 	    fclose (message_fp);
-	} else {
-	    if (!message_extract (infile, outfile))
-		return (1);
-	}
-
-	if (outfile != stdout)
+	if (outfile != NULL && outfile != stdout)
 	    fclose (outfile);
-	if (infile != stdout)
+	if (infile != NULL && infile != stdin)
 	    fclose (infile);
 
-	return (0);
+	return (ok ? 0 : 1);
 }
@@ -0,0 +1,119 @@
+/*
+ * Generate the factorial tables for the gifshuffle steganography program.
+ * The tables are written to standard output as a C header, which is
+ * included by encode.c.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+
+/*
+ * Table dimensions. 256! is just under 2^1684, so 53 32-bit limbs are
+ * enough to hold any of the values.
+ */
+
+#define FACT_MAX	256
+#define FACT_LIMBS	53
+
+
+/*
+ * Multiply a limb array by a small integer.
+ */
+
+static void
+limbs_multiply (
+	uint32_t	*limbs,
+	int		n
+) {
+	unsigned long long	carry = 0;
+	int			i;
+
+	for (i=0; i<FACT_LIMBS; i++) {
+	    carry += (unsigned long long) limbs[i] * n;
+	    limbs[i] = (uint32_t) carry;
+	    carry >>= 32;
+	}
+}
+
+
+/*
+ * Return the number of significant bits in a limb array.
+ */
+
+static int
+limbs_bit_length (
+	const uint32_t	*limbs
+) {
+	int		i, b;
+
+	for (i = FACT_LIMBS - 1; i >= 0; i--)
+	    if (limbs[i] != 0) {
+		for (b = 31; (limbs[i] & ((uint32_t) 1 << b)) == 0; b--)
+		    ;
+		return (i * 32 + b + 1);
+	    }
+
+	return (0);
+}
+
+
+/*
+ * Program's starting point.
+ */
+
+int
+main (void)
+{
+	uint32_t	fact[FACT_LIMBS], fm1[FACT_LIMBS];
+	int		i, n;
+
+	printf ("/*\n");
+	printf (" * Factorial tables for the gifshuffle steganography ");
+	printf ("program.\n");
+	printf (" * Generated by mkfact - do not edit.\n");
+	printf (" */\n\n");
+	printf ("#define FACT_MAX\t%d\n", FACT_MAX);
+	printf ("#define FACT_LIMBS\t%d\n\n", FACT_LIMBS);
+
+	for (i=0; i<FACT_LIMBS; i++)
+	    fact[i] = 0;
+	fact[0] = 1;
+
+	printf ("\t/* floor (log2 (n!)) */\n");
+	printf ("static const short\tfact_log2[FACT_MAX + 1] = {");
+	for (n = 0; n <= FACT_MAX; n++) {
+	    if (n > 1)
+		limbs_multiply (fact, n);
+	    printf ("%s%4d,", (n % 12) == 0 ? "\n\t" : " ",
+					limbs_bit_length (fact) - 1);
+	}
+	printf ("\n};\n\n");
+
+	for (i=0; i<FACT_LIMBS; i++)
+	    fact[i] = 0;
+	fact[0] = 1;
+
+	printf ("\t/* n! - 1, as 32-bit limbs, least significant first */\n");
+	printf ("static const uint32_t\t");
+	printf ("fact_minus_one[FACT_MAX + 1][FACT_LIMBS] = {\n");
+	for (n = 0; n <= FACT_MAX; n++) {
+	    if (n > 1)
+		limbs_multiply (fact, n);
+
+	    for (i=0; i<FACT_LIMBS; i++)
+		fm1[i] = fact[i];
+	    for (i=0; fm1[i] == 0; i++)
+		fm1[i] = 0xffffffffUL;
+	    fm1[i]--;
+
+	    printf ("    {\t\t\t\t\t/* %d! - 1 */", n);
+	    for (i=0; i<FACT_LIMBS; i++)
+		printf ("%s0x%08lx,", (i % 5) == 0 ? "\n\t" : " ",
+						(unsigned long) fm1[i]);
+	    printf ("\n    },\n");
+	}
+	printf ("};\n");
+
+	return (0);
+}
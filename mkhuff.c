@@ -0,0 +1,99 @@
+/*
+ * Generate the Huffman code tables for the gifshuffle steganography
+ * program. The code strings in huffcode.h and the tables trained by
+ * hufftrain are checked, and converted into (code, length) pairs,
+ * which are written to standard output as a C header included by
+ * hufftab.c.
+ */
+
+#include <stdio.h>
+
+
+/*
+ * The longest code that fits in the table.
+ */
+
+#define HUFF_MAX_LENGTH	24
+
+
+/*
+ * The Huffman code tables, as strings of '0' and '1', with their names.
+ * A table's position is its ID, which is recorded in payload headers,
+ * so new tables must only ever be added at the end.
+ */
+
+#define HUFF_TABLES	4
+
+static const char	*huffcodes[HUFF_TABLES][256] = {
+	{
+#include "huffcode.h"
+	}, {
+#include "huffjson.h"
+	}, {
+#include "huffb64.h"
+	}, {
+#include "huffutf8.h"
+	}
+};
+
+static const char	*huff_names[HUFF_TABLES] = {
+	"english", "json", "base64", "utf8"
+};
+
+
+/*
+ * Program's starting point.
+ * Converts each code string and prints it.
+ */
+
+int
+main (void)
+{
+	int		i, t;
+
+	printf ("/*\n");
+	printf (" * Huffman codes as (code, length) pairs.\n");
+	printf (" * Generated by mkhuff - do not edit.\n");
+	printf (" */\n\n");
+
+	printf ("const char\t*huff_table_names[%d] = {\n", HUFF_TABLES);
+	for (t=0; t<HUFF_TABLES; t++)
+	    printf ("\t\"%s\",\n", huff_names[t]);
+	printf ("};\n\n");
+
+	printf ("const HUFF_CODE\thuff_codes[%d][256] = {", HUFF_TABLES);
+
+	for (t=0; t<HUFF_TABLES; t++) {
+	    printf ("\n    {");
+
+	    for (i=0; i<256; i++) {
+		const char	*s;
+		unsigned long	code = 0;
+		int		len = 0;
+
+		for (s = huffcodes[t][i]; *s != '\0'; s++, len++) {
+		    if (*s != '0' && *s != '1') {
+			fprintf (stderr, "Illegal Huffman character '%c'\n",
+									*s);
+			return (1);
+		    }
+		    code = (code << 1) | (*s == '1');
+		}
+
+		if (len == 0 || len > HUFF_MAX_LENGTH) {
+		    fprintf (stderr, "Huffman code %d of table %s has %s %d\n",
+					i, huff_names[t], "bad length", len);
+		    return (1);
+		}
+
+		printf ("%s{0x%06lx, %2d},", (i % 4) == 0 ? "\n\t" : " ",
+								code, len);
+	    }
+
+	    printf ("\n    },");
+	}
+
+	printf ("\n};\n");
+
+	return (0);
+}
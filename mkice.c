@@ -0,0 +1,145 @@
+/*
+ * Generate the ICE S-box tables.
+ * The tables are written to standard output as a C header, which is
+ * included by ice.c.
+ *
+ * The S-box code is taken from the ICE implementation by Matthew Kwan.
+ */
+
+#include <stdio.h>
+
+
+	/* Modulo values for the S-boxes */
+static const int	ice_smod[4][4] = {
+				{333, 313, 505, 369},
+				{379, 375, 319, 391},
+				{361, 445, 451, 397},
+				{397, 425, 395, 505}};
+
+	/* XOR values for the S-boxes */
+static const int	ice_sxor[4][4] = {
+				{0x83, 0x85, 0x9b, 0xcd},
+				{0xcc, 0xa7, 0xad, 0x41},
+				{0x4b, 0x2e, 0xd4, 0x33},
+				{0xea, 0xcb, 0x2e, 0x04}};
+
+	/* Expanded permutation values for the P-box */
+static const unsigned long	ice_pbox[32] = {
+		0x00000001, 0x00000080, 0x00000400, 0x00002000,
+		0x00080000, 0x00200000, 0x01000000, 0x40000000,
+		0x00000008, 0x00000020, 0x00000100, 0x00004000,
+		0x00010000, 0x00800000, 0x04000000, 0x20000000,
+		0x00000004, 0x00000010, 0x00000200, 0x00008000,
+		0x00020000, 0x00400000, 0x08000000, 0x10000000,
+		0x00000002, 0x00000040, 0x00000800, 0x00001000,
+		0x00040000, 0x00100000, 0x02000000, 0x80000000};
+
+
+/*
+ * Galois Field multiplication of a by b, modulo m.
+ * Just like arithmetic multiplication, except that additions and
+ * subtractions are replaced by XOR.
+ */
+
+static unsigned int
+gf_mult (
+	register unsigned int	a,
+	register unsigned int	b,
+	register unsigned int	m
+) {
+	register unsigned int	res = 0;
+
+	while (b) {
+	    if (b & 1)
+		res ^= a;
+
+	    a <<= 1;
+	    b >>= 1;
+
+	    if (a >= 256)
+		a ^= m;
+	}
+
+	return (res);
+}
+
+
+/*
+ * Galois Field exponentiation.
+ * Raise the base to the power of 7, modulo m.
+ */
+
+static unsigned long
+gf_exp7 (
+	register unsigned int	b,
+	unsigned int		m
+) {
+	register unsigned int	x;
+
+	if (b == 0)
+	    return (0);
+
+	x = gf_mult (b, b, m);
+	x = gf_mult (b, x, m);
+	x = gf_mult (x, x, m);
+	return (gf_mult (b, x, m));
+}
+
+
+/*
+ * Carry out the ICE 32-bit P-box permutation.
+ */
+
+static unsigned long
+ice_perm32 (
+	register unsigned long	x
+) {
+	register unsigned long		res = 0;
+	register const unsigned long	*pbox = ice_pbox;
+
+	while (x) {
+	    if (x & 1)
+		res |= *pbox;
+	    pbox++;
+	    x >>= 1;
+	}
+
+	return (res);
+}
+
+
+/*
+ * Program's starting point.
+ * Calculates each S-box entry and prints it.
+ */
+
+int
+main (void)
+{
+	int		i, s;
+
+	printf ("/*\n");
+	printf (" * ICE S-box tables, with the P-box permutation applied.\n");
+	printf (" * Generated by mkice - do not edit.\n");
+	printf (" */\n\n");
+	printf ("static const uint32_t\tice_sbox[4][1024] = {\n");
+
+	for (s=0; s<4; s++) {
+	    printf ("    {");
+	    for (i=0; i<1024; i++) {
+		int		col = (i >> 1) & 0xff;
+		int		row = (i & 0x1) | ((i & 0x200) >> 8);
+		unsigned long	x;
+
+		x = gf_exp7 (col ^ ice_sxor[s][row], ice_smod[s][row])
+							<< (24 - s * 8);
+		printf ("%s0x%08lx,", (i % 6) == 0 ? "\n\t" : " ",
+							ice_perm32 (x));
+	    }
+	    printf ("\n    },\n");
+	}
+
+	printf ("};\n");
+
+	return (0);
+}
@@ -0,0 +1,697 @@
+/*
+ * Persistent palette cache for the gifshuffle steganography program.
+ *
+ * The cache is a file of fixed-size slots, indexed by a hash of the
+ * colourmap bytes, and mapped into memory. Readers never lock. Each
+ * slot has a sequence number which is odd while the slot is being
+ * written, so a reader copies the slot and then checks that the
+ * sequence number was even and did not change. Writers serialise
+ * with an fcntl() lock on the file. That lock belongs to the process,
+ * so writers within a process also take a mutex, which is the only
+ * state shared between the caches a process opens.
+ * Each open cache has its own mapping, and is used by one context,
+ * so one thread, at a time.
+ *
+ * The file starts small, and doubles in size whenever a colourmap
+ * finds no free slot, up to a limit. Other processes notice the new
+ * size in the header, and map the file again.
+ */
+
+#include "gifshuf.h"
+#include "pcache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (unix) || defined (__unix__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#define PCACHE_MMAP
+#endif
+
+
+/*
+ * File layout.
+ */
+
+#define PCACHE_MAGIC	"GSPCACHE"
+#define PCACHE_VERSION	2
+#define PCACHE_MIN_SLOTS	64
+#define PCACHE_MAX_SLOTS	8192
+#define PCACHE_PROBES	8
+
+typedef struct {
+	char		ph_magic[8];
+	uint32_t	ph_version;
+	uint32_t	ph_nslots;
+	uint32_t	ph_slot_size;
+	uint32_t	ph_byte_order;
+} PCACHE_HEADER;
+
+typedef struct {
+	uint32_t	ps_seq;			/* Odd while being written */
+	uint32_t	ps_ncolours;		/* Size of the colourmap */
+	uint64_t	ps_hash;		/* Zero if the slot is empty */
+	uint32_t	ps_nunique;
+	uint32_t	ps_reserved;
+	unsigned char	ps_colourmap[768];
+	unsigned char	ps_first[256];
+	unsigned char	ps_order[256];
+} PCACHE_SLOT;
+
+#define PCACHE_FILE_SIZE(nslots)	(sizeof (PCACHE_HEADER) \
+				+ (size_t) (nslots) * sizeof (PCACHE_SLOT))
+
+
+/*
+ * Memory barriers and atomic access to the sequence numbers.
+ */
+
+#ifdef __GNUC__
+#define SEQ_LOAD(p)	__atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define SEQ_STORE(p, v)	__atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#define SEQ_FENCE()	__atomic_thread_fence (__ATOMIC_SEQ_CST)
+#else
+#define SEQ_LOAD(p)	(*(volatile uint32_t *) (p))
+#define SEQ_STORE(p, v)	(*(volatile uint32_t *) (p) = (v))
+#define SEQ_FENCE()
+#endif
+
+
+/*
+ * An open cache file, and its mapping.
+ */
+
+struct pcache_struct {
+	int		pc_fd;
+	BOOL		pc_writable;
+	unsigned char	*pc_map;
+	size_t		pc_map_size;
+	PCACHE_SLOT	*pc_slots;
+	uint32_t	pc_nslots;
+};
+
+
+/*
+ * Local variables.
+ */
+
+#ifdef PCACHE_MMAP
+static pthread_mutex_t	pcache_write_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+/*
+ * Calculate the hash of a colourmap.
+ * Zero is reserved for empty slots.
+ */
+
+static uint64_t
+colourmap_hash (
+	const GIFINFO	*gi
+) {
+	uint64_t	h = 0xcbf29ce484222325ULL;
+	int		i;
+
+	for (i=0; i<gi->gi_num_colours; i++) {
+	    const RGB	*rgb = &gi->gi_colours[i];
+
+	    h = (h ^ rgb->r) * 0x100000001b3ULL;
+	    h = (h ^ rgb->g) * 0x100000001b3ULL;
+	    h = (h ^ rgb->b) * 0x100000001b3ULL;
+	}
+
+	return (h == 0 ? 1 : h);
+}
+
+
+/*
+ * Check if a slot holds the given colourmap.
+ */
+
+static BOOL
+slot_match (
+	const PCACHE_SLOT	*ps,
+	const GIFINFO		*gi
+) {
+	int			i;
+
+	if ((int) ps->ps_ncolours != gi->gi_num_colours)
+	    return (FALSE);
+
+	for (i=0; i<gi->gi_num_colours; i++) {
+	    const RGB	*rgb = &gi->gi_colours[i];
+
+	    if (ps->ps_colourmap[i*3] != rgb->r
+				|| ps->ps_colourmap[i*3 + 1] != rgb->g
+				|| ps->ps_colourmap[i*3 + 2] != rgb->b)
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+
+/*
+ * Pack a colourmap entry into a 24-bit integer.
+ */
+
+static uint32_t
+colour_value (
+	const GIFINFO	*gi,
+	int		i
+) {
+	const RGB	*rgb = &gi->gi_colours[i];
+
+	return (((uint32_t) rgb->r << 16) | ((uint32_t) rgb->g << 8) | rgb->b);
+}
+
+
+/*
+ * Find a colour in the first n unique colours of a slot, using their
+ * natural order, which has been checked. Returns the entry where the
+ * colour first appears, or -1 if it isn't there.
+ */
+
+static int
+slot_colour_find (
+	const PCACHE_SLOT	*ps,
+	const GIFINFO		*gi,
+	int			n,
+	uint32_t		v
+) {
+	int			lo = 0, hi = n - 1;
+
+	while (lo <= hi) {
+	    int		mid = (lo + hi) / 2;
+	    int		first = ps->ps_first[ps->ps_order[mid]];
+	    uint32_t	mv = colour_value (gi, first);
+
+	    if (mv == v)
+		return (first);
+	    else if (mv < v)
+		lo = mid + 1;
+	    else
+		hi = mid - 1;
+	}
+
+	return (-1);
+}
+
+
+/*
+ * Check that the analysis in a slot really describes the colourmap,
+ * so that a damaged or planted cache file can't give wrong results.
+ * The unique colours must be listed in order of first appearance, and
+ * the natural order must list each of them once, in strictly
+ * increasing RGB order, which also shows that they are unique. Every
+ * other entry must then be a copy of one that appeared before it,
+ * which is found by binary search of the natural order.
+ */
+
+static BOOL
+slot_valid (
+	const PCACHE_SLOT	*ps,
+	const GIFINFO		*gi
+) {
+	int			n = ps->ps_nunique, ncols = gi->gi_num_colours;
+	int			i, k;
+	unsigned char		seen[256];
+
+	if (!slot_match (ps, gi) || n > ncols || (n == 0 && ncols > 0))
+	    return (FALSE);
+
+	for (i=0; i<n; i++)
+	    if (ps->ps_first[i] >= ncols
+			|| (i > 0 && ps->ps_first[i] <= ps->ps_first[i - 1]))
+		return (FALSE);
+
+	memset (seen, 0, sizeof (seen));
+	for (i=0; i<n; i++) {
+	    int		o = ps->ps_order[i];
+
+	    if (o >= n || seen[o])
+		return (FALSE);
+	    seen[o] = 1;
+
+	    if (i > 0 && colour_value (gi, ps->ps_first[o])
+			<= colour_value (gi, ps->ps_first[ps->ps_order[i - 1]]))
+		return (FALSE);
+	}
+
+	for (i=0, k=0; i<ncols; i++) {
+	    int		first;
+
+	    if (k < n && ps->ps_first[k] == i) {
+		k++;
+		continue;
+	    }
+
+	    first = slot_colour_find (ps, gi, n, colour_value (gi, i));
+	    if (first < 0 || first > i)
+		return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+
+#ifdef PCACHE_MMAP
+
+/*
+ * Lock or unlock the cache file for writing.
+ * The mutex keeps out other threads, and the fcntl() lock other
+ * processes.
+ */
+
+static BOOL
+pcache_lock (
+	PCACHE		*pc,
+	int		type
+) {
+	struct flock	fl;
+	BOOL		ok;
+
+	if (type != F_UNLCK)
+	    pthread_mutex_lock (&pcache_write_mutex);
+
+	memset (&fl, 0, sizeof (fl));
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+
+	ok = (fcntl (pc->pc_fd, F_SETLKW, &fl) == 0);
+
+	if (type == F_UNLCK || !ok)
+	    pthread_mutex_unlock (&pcache_write_mutex);
+
+	return (ok);
+}
+
+
+/*
+ * Initialize an empty cache file, with the fewest slots.
+ */
+
+static BOOL
+pcache_create (
+	PCACHE		*pc
+) {
+	PCACHE_HEADER	ph;
+
+	memset (&ph, 0, sizeof (ph));
+	memcpy (ph.ph_magic, PCACHE_MAGIC, 8);
+	ph.ph_version = PCACHE_VERSION;
+	ph.ph_nslots = PCACHE_MIN_SLOTS;
+	ph.ph_slot_size = sizeof (PCACHE_SLOT);
+	ph.ph_byte_order = 0x01020304;
+
+	if (ftruncate (pc->pc_fd, PCACHE_FILE_SIZE (PCACHE_MIN_SLOTS)) != 0
+		|| pwrite (pc->pc_fd, &ph, sizeof (ph), 0) != sizeof (ph))
+	    return (FALSE);
+
+	return (TRUE);
+}
+
+
+/*
+ * Map the cache file into memory, with the given number of slots.
+ */
+
+static BOOL
+pcache_map_slots (
+	PCACHE		*pc,
+	uint32_t	nslots
+) {
+	struct stat	st;
+	size_t		size = PCACHE_FILE_SIZE (nslots);
+	int		prot = PROT_READ;
+
+	if (pc->pc_writable)
+	    prot |= PROT_WRITE;
+
+	if (pc->pc_map != NULL)
+	    munmap (pc->pc_map, pc->pc_map_size);
+	pc->pc_map = NULL;
+	pc->pc_slots = NULL;
+	pc->pc_nslots = 0;
+
+	if (fstat (pc->pc_fd, &st) != 0 || st.st_size < (off_t) size)
+	    return (FALSE);
+
+	pc->pc_map = mmap (NULL, size, prot, MAP_SHARED, pc->pc_fd, 0);
+	if (pc->pc_map == MAP_FAILED) {
+	    pc->pc_map = NULL;
+	    return (FALSE);
+	}
+
+	pc->pc_map_size = size;
+	pc->pc_nslots = nslots;
+	pc->pc_slots = (PCACHE_SLOT *) (pc->pc_map + sizeof (PCACHE_HEADER));
+
+	return (TRUE);
+}
+
+
+/*
+ * Map the file again if another process has grown it.
+ * Returns FALSE if the cache can no longer be used.
+ */
+
+static BOOL
+pcache_sync (
+	PCACHE		*pc
+) {
+	const PCACHE_HEADER	*ph = (const PCACHE_HEADER *) pc->pc_map;
+	uint32_t		nslots = SEQ_LOAD (&ph->ph_nslots);
+
+	if (nslots == pc->pc_nslots)
+	    return (TRUE);
+
+	if (nslots < pc->pc_nslots || nslots > PCACHE_MAX_SLOTS)
+	    return (FALSE);
+
+	return (pcache_map_slots (pc, nslots));
+}
+
+
+/*
+ * Find a slot for a colourmap's hash, either one already holding the
+ * colourmap, or an empty one. If gi is NULL, only empty slots are used.
+ * Returns NULL if none of the slots probed are suitable.
+ */
+
+static PCACHE_SLOT *
+slot_find (
+	const PCACHE	*pc,
+	uint64_t	h,
+	const GIFINFO	*gi
+) {
+	uint32_t	i;
+
+	for (i=0; i<PCACHE_PROBES; i++) {
+	    PCACHE_SLOT	*s = &pc->pc_slots[(h + i) % pc->pc_nslots];
+
+	    if (s->ps_hash == 0 || (gi != NULL && s->ps_hash == h
+						&& slot_match (s, gi)))
+		return (s);
+	}
+
+	return (NULL);
+}
+
+
+/*
+ * Write an entry into a slot, or clear the slot if entry is NULL.
+ * The sequence number is odd while the slot is being written.
+ */
+
+static void
+slot_write (
+	PCACHE_SLOT		*ps,
+	const PCACHE_SLOT	*entry
+) {
+	uint32_t		seq = ps->ps_seq;
+
+	SEQ_STORE (&ps->ps_seq, seq | 1);
+	SEQ_FENCE ();
+
+	if (entry == NULL)
+	    ps->ps_hash = 0;
+	else
+	    memcpy ((char *) ps + sizeof (ps->ps_seq),
+			(const char *) entry + sizeof (entry->ps_seq),
+			sizeof (PCACHE_SLOT) - sizeof (ps->ps_seq));
+
+	SEQ_FENCE ();
+	SEQ_STORE (&ps->ps_seq, (seq | 1) + 1);
+}
+
+
+/*
+ * Double the number of slots, and move the entries to their slots in
+ * the larger table. Entries that find no slot are dropped.
+ * The file must be locked for writing.
+ */
+
+static BOOL
+pcache_grow (
+	PCACHE		*pc
+) {
+	uint32_t	i, n = 0, nslots = pc->pc_nslots * 2;
+	PCACHE_SLOT	*saved;
+	PCACHE_HEADER	*ph;
+
+	if ((saved = (PCACHE_SLOT *) malloc (pc->pc_nslots
+					* sizeof (PCACHE_SLOT))) == NULL)
+	    return (FALSE);
+
+	for (i=0; i<pc->pc_nslots; i++)
+	    if (pc->pc_slots[i].ps_hash != 0)
+		memcpy (&saved[n++], &pc->pc_slots[i], sizeof (PCACHE_SLOT));
+
+	if (ftruncate (pc->pc_fd, PCACHE_FILE_SIZE (nslots)) != 0) {
+	    free (saved);
+	    return (FALSE);
+	}
+
+	if (!pcache_map_slots (pc, nslots)) {
+	    free (saved);
+	    return (FALSE);
+	}
+
+	for (i=0; i<nslots / 2; i++)
+	    if (pc->pc_slots[i].ps_hash != 0)
+		slot_write (&pc->pc_slots[i], NULL);
+
+	for (i=0; i<n; i++) {
+	    PCACHE_SLOT	*ps = slot_find (pc, saved[i].ps_hash, NULL);
+
+	    if (ps != NULL)
+		slot_write (ps, &saved[i]);
+	}
+
+	free (saved);
+
+		/* Readers in other processes see the new size last */
+	ph = (PCACHE_HEADER *) pc->pc_map;
+	SEQ_STORE (&ph->ph_nslots, nslots);
+
+	return (TRUE);
+}
+
+#endif
+
+
+/*
+ * Open a palette cache file, creating it if necessary.
+ * If the file can't be written, it is used read-only.
+ * Returns NULL if the cache can't be used.
+ */
+
+PCACHE *
+pcache_open (
+	const char	*path
+) {
+#ifdef PCACHE_MMAP
+	struct stat	st;
+	PCACHE_HEADER	ph;
+	PCACHE		*pc;
+
+	if ((pc = (PCACHE *) calloc (1, sizeof (PCACHE))) == NULL) {
+	    fprintf (stderr, "Out of memory for palette cache.\n");
+	    return (NULL);
+	}
+
+	if ((pc->pc_fd = open (path, O_RDWR | O_CREAT, 0600)) >= 0)
+	    pc->pc_writable = TRUE;
+	else if ((pc->pc_fd = open (path, O_RDONLY)) < 0) {
+	    perror (path);
+	    free (pc);
+	    return (NULL);
+	}
+
+	if (pc->pc_writable) {
+	    BOOL	ok = TRUE;
+
+	    if (!pcache_lock (pc, F_WRLCK)) {
+		perror (path);
+		pcache_close (pc);
+		return (NULL);
+	    }
+
+	    if (fstat (pc->pc_fd, &st) == 0 && st.st_size == 0)
+		ok = pcache_create (pc);
+
+	    pcache_lock (pc, F_UNLCK);
+
+	    if (!ok) {
+		perror (path);
+		pcache_close (pc);
+		return (NULL);
+	    }
+	}
+
+	if (pread (pc->pc_fd, &ph, sizeof (ph), 0) != sizeof (ph)
+		    || memcmp (ph.ph_magic, PCACHE_MAGIC, 8) != 0
+		    || ph.ph_version != PCACHE_VERSION
+		    || ph.ph_slot_size != sizeof (PCACHE_SLOT)
+		    || ph.ph_byte_order != 0x01020304
+		    || ph.ph_nslots == 0 || ph.ph_nslots > PCACHE_MAX_SLOTS
+		    || !pcache_map_slots (pc, ph.ph_nslots)) {
+	    fprintf (stderr, "Warning: palette cache %s is not valid\n", path);
+	    pcache_close (pc);
+	    return (NULL);
+	}
+
+	return (pc);
+#else
+	fprintf (stderr, "Warning: palette cache not supported\n");
+	return (NULL);
+#endif
+}
+
+
+/*
+ * Close a palette cache. A NULL cache is ignored.
+ */
+
+void
+pcache_close (
+	PCACHE		*pc
+) {
+	if (pc == NULL)
+	    return;
+
+#ifdef PCACHE_MMAP
+	if (pc->pc_map != NULL)
+	    munmap (pc->pc_map, pc->pc_map_size);
+
+		/* Closing the file drops this process's lock on it, even
+		 * one taken through another descriptor, so wait until no
+		 * other thread is writing.
+		 */
+	if (pc->pc_fd >= 0) {
+	    pthread_mutex_lock (&pcache_write_mutex);
+	    close (pc->pc_fd);
+	    pthread_mutex_unlock (&pcache_write_mutex);
+	}
+#endif
+
+	free (pc);
+}
+
+
+/*
+ * Is a palette cache in use?
+ */
+
+BOOL
+pcache_active (
+	const PCACHE	*pc
+) {
+	return (pc != NULL && pc->pc_slots != NULL);
+}
+
+
+/*
+ * Look up a colourmap in a cache, which may be NULL.
+ * Returns FALSE if it isn't there, if the slot is being written, or if
+ * the entry is not valid.
+ */
+
+BOOL
+pcache_lookup (
+	PCACHE		*pc,
+	const GIFINFO	*gi,
+	PCACHE_INFO	*pi
+) {
+#ifdef PCACHE_MMAP
+	uint64_t	h;
+	uint32_t	i;
+
+	if (!pcache_active (pc) || !pcache_sync (pc))
+	    return (FALSE);
+
+	h = colourmap_hash (gi);
+
+	for (i=0; i<PCACHE_PROBES; i++) {
+	    PCACHE_SLOT	*ps = &pc->pc_slots[(h + i) % pc->pc_nslots];
+	    PCACHE_SLOT	copy;
+	    uint32_t	seq = SEQ_LOAD (&ps->ps_seq);
+
+	    if ((seq & 1) != 0 || ps->ps_hash != h)
+		continue;
+
+	    memcpy (&copy, ps, sizeof (copy));
+	    SEQ_FENCE ();
+	    if (SEQ_LOAD (&ps->ps_seq) != seq || copy.ps_hash != h
+					|| !slot_valid (&copy, gi))
+		continue;
+
+	    pi->pi_nunique = copy.ps_nunique;
+	    memcpy (pi->pi_first, copy.ps_first, sizeof (pi->pi_first));
+	    memcpy (pi->pi_order, copy.ps_order, sizeof (pi->pi_order));
+
+	    return (TRUE);
+	}
+#endif
+
+	return (FALSE);
+}
+
+
+/*
+ * Store the analysis of a colourmap in a cache, which may be NULL.
+ * Uses an empty slot if there is one, growing the file if needed,
+ * otherwise replaces the first slot probed.
+ */
+
+void
+pcache_store (
+	PCACHE			*pc,
+	const GIFINFO		*gi,
+	const PCACHE_INFO	*pi
+) {
+#ifdef PCACHE_MMAP
+	PCACHE_SLOT		entry, *ps;
+	uint64_t		h;
+	int			i;
+
+	if (!pcache_active (pc) || !pc->pc_writable)
+	    return;
+
+	h = colourmap_hash (gi);
+
+	memset (&entry, 0, sizeof (entry));
+	entry.ps_hash = h;
+	entry.ps_ncolours = gi->gi_num_colours;
+	entry.ps_nunique = pi->pi_nunique;
+	for (i=0; i<gi->gi_num_colours; i++) {
+	    entry.ps_colourmap[i*3] = gi->gi_colours[i].r;
+	    entry.ps_colourmap[i*3 + 1] = gi->gi_colours[i].g;
+	    entry.ps_colourmap[i*3 + 2] = gi->gi_colours[i].b;
+	}
+	memcpy (entry.ps_first, pi->pi_first, sizeof (entry.ps_first));
+	memcpy (entry.ps_order, pi->pi_order, sizeof (entry.ps_order));
+
+	if (!pcache_lock (pc, F_WRLCK))
+	    return;
+
+	if (pcache_sync (pc)) {
+	    if ((ps = slot_find (pc, h, gi)) == NULL
+			&& pc->pc_nslots < PCACHE_MAX_SLOTS && pcache_grow (pc))
+		ps = slot_find (pc, h, gi);
+
+	    if (ps == NULL && pc->pc_slots != NULL)
+		ps = &pc->pc_slots[h % pc->pc_nslots];
+
+	    if (ps != NULL)
+		slot_write (ps, &entry);
+	}
+
+	pcache_lock (pc, F_UNLCK);
+#endif
+}
@@ -0,0 +1,33 @@
+/*
+ * Persistent palette cache.
+ */
+
+#ifndef _PCACHE_H
+#define _PCACHE_H
+
+#include "gif.h"
+
+
+/*
+ * The cached analysis of a colourmap.
+ */
+
+typedef struct {
+	int		pi_nunique;		/* Number of unique colours */
+	unsigned char	pi_first[256];		/* Entry of each unique colour */
+	unsigned char	pi_order[256];		/* Unique colours in RGB order */
+} PCACHE_INFO;
+
+
+/*
+ * Define external functions.
+ */
+
+extern PCACHE	*pcache_open (const char *path);
+extern void	pcache_close (PCACHE *pc);
+extern BOOL	pcache_active (const PCACHE *pc);
+extern BOOL	pcache_lookup (PCACHE *pc, const GIFINFO *gi, PCACHE_INFO *pi);
+extern void	pcache_store (PCACHE *pc, const GIFINFO *gi,
+						const PCACHE_INFO *pi);
+
+#endif
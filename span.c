@@ -0,0 +1,80 @@
+/*
+ * Bit spans for the gifshuffle steganography program.
+ * The payload is passed between the compression, encryption and
+ * encoding stages as spans of bits, packed most significant bit first
+ * into 64-bit words, so that each stage can work a word at a time.
+ */
+
+#include "gifshuf.h"
+
+
+/*
+ * Return nbits bits, from 1 to 64, starting at bit pos of a span,
+ * in the bottom bits of a word.
+ */
+
+uint64_t
+span_read (
+	const uint64_t	*words,
+	int		pos,
+	int		nbits
+) {
+	int		i = pos >> 6, b = pos & 63;
+	uint64_t	v = words[i] << b;
+
+	if (b + nbits > 64)
+	    v |= words[i + 1] >> (64 - b);
+
+	return (v >> (64 - nbits));
+}
+
+
+/*
+ * Write the bottom nbits bits of a word, from 1 to 64, into a span
+ * starting at bit pos. Any bits after them in the same word are
+ * cleared, so a span is built by writing to its end.
+ */
+
+void
+span_write (
+	uint64_t	*words,
+	int		pos,
+	uint64_t	value,
+	int		nbits
+) {
+	int		i = pos >> 6, b = pos & 63;
+
+	value <<= 64 - nbits;
+
+	if (b == 0)
+	    words[i] = value;
+	else
+	    words[i] = (words[i] & (~(uint64_t) 0 << (64 - b))) | (value >> b);
+
+	if (b + nbits > 64)
+	    words[i + 1] = value << (64 - b);
+}
+
+
+/*
+ * Copy nbits bits from one span, starting at bit src_pos, into another
+ * starting at bit dst_pos.
+ */
+
+void
+span_copy (
+	uint64_t	*dst,
+	int		dst_pos,
+	const uint64_t	*src,
+	int		src_pos,
+	int		nbits
+) {
+	while (nbits > 0) {
+	    int		n = (nbits < 64) ? nbits : 64;
+
+	    span_write (dst, dst_pos, span_read (src, src_pos, n), n);
+	    dst_pos += n;
+	    src_pos += n;
+	    nbits -= n;
+	}
+}
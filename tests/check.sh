@@ -0,0 +1,136 @@
+#!/bin/sh
+#
+# Regression tests for gifshuffle.
+#
+# Usage: check.sh [gifshuffle [test ...]]
+#
+# Runs the named tests, or every *.test script in this directory, each
+# of which checks one feature with the functions below. The carriers
+# and messages they use are in data/. The files in golden/ were made by
+# gifshuffle 2.0, so the modes it had must still produce them byte for
+# byte, except for those of newer modes, named by their tests, which
+# pin their formats. Test programs are built in this directory by
+# "make check".
+#
+
+G=${1:-./gifshuffle}
+DIR=`dirname "$0"`
+DATA="$DIR/data"
+GOLDEN="$DIR/golden"
+TMP=`mktemp -d` || exit 1
+trap '/bin/rm -rf "$TMP"' 0 1 2 15
+
+fail=0
+count=0
+
+#
+# Report a failed test.
+#
+
+failed () {
+	echo "FAIL: $*"
+	fail=`expr $fail + 1`
+}
+
+#
+# Print the name of the message file used with the golden files of
+# the carrier $1, which is the longest that fits.
+#
+
+message () {
+	case $1 in
+	c16)		echo "$DATA/tiny.txt" ;;
+	c64|c100)	echo "$DATA/short.txt" ;;
+	*)		echo "$DATA/msg.txt" ;;
+	esac
+}
+
+#
+# Conceal the file $2 in the carrier $1 with options $3, extract it
+# with options $4, and compare the result with the original.
+# The concealed file is left in $TMP/out.gif.
+#
+
+roundtrip () {
+	count=`expr $count + 1`
+	if ! $G -Q $3 -f "$2" "$DATA/$1.gif" "$TMP/out.gif" 2> "$TMP/err"
+	then
+		failed "embed $1 [$3]: `cat $TMP/err`"
+		return
+	fi
+	if ! $G -Q $4 "$TMP/out.gif" > "$TMP/msg" 2> "$TMP/err"
+	then
+		failed "extract $1 [$3] [$4]: `cat $TMP/err`"
+		return
+	fi
+	cmp -s "$2" "$TMP/msg" || failed "roundtrip $1 [$3] [$4]"
+}
+
+#
+# Conceal the file $2 in the carrier $1 with options $3, and compare
+# the result with golden/$1-$4.gif.
+#
+
+golden () {
+	count=`expr $count + 1`
+	if ! $G -Q $3 -f "$2" "$DATA/$1.gif" "$TMP/out.gif" 2> "$TMP/err"
+	then
+		failed "embed $1 [$3]: `cat $TMP/err`"
+		return
+	fi
+	cmp -s "$GOLDEN/$1-$4.gif" "$TMP/out.gif" \
+		|| failed "golden $1-$4 [$3]"
+}
+
+#
+# Extract a message from the file $1 with options $2, and compare it
+# with the file $3.
+#
+
+extract () {
+	count=`expr $count + 1`
+	if ! $G -Q $2 "$1" > "$TMP/msg" 2> "$TMP/err"
+	then
+		failed "extract $1 [$2]: `cat $TMP/err`"
+		return
+	fi
+	cmp -s "$3" "$TMP/msg" || failed "extract $1 [$2]"
+}
+
+#
+# Run a command, which must fail with an error containing $1.
+#
+
+mustfail () {
+	count=`expr $count + 1`
+	pattern=$1
+	shift
+	if "$@" > /dev/null 2> "$TMP/err"
+	then
+		failed "$* should have failed"
+	elif ! grep -q "$pattern" "$TMP/err"
+	then
+		failed "$*: `cat $TMP/err`"
+	fi
+}
+
+if [ $# -gt 1 ]
+then
+	shift
+	tests="$*"
+else
+	tests=`ls "$DIR"/*.test`
+fi
+
+for t in $tests
+do
+	. "$t"
+done
+
+if [ $fail != 0 ]
+then
+	echo "$fail of $count tests failed"
+	exit 1
+fi
+echo "All $count tests passed"
+exit 0
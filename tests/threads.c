@@ -0,0 +1,273 @@
+/*
+ * Test the gifshuffle library from several threads at once.
+ *
+ * Usage: threads carrier.gif golden.gif message
+ *
+ * Each thread conceals and extracts messages with its own handle and
+ * with the one-shot calls, using a different mix of options, and
+ * checks that a message concealed with the password "hello" matches
+ * the golden file, and that a handle for another password does not
+ * extract it. Built with "make clean check CC='gcc
+ * -fsanitize=thread'", ThreadSanitizer checks the library for races.
+ */
+
+#include "gifshuffle.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+ * The number of threads, and of messages each conceals.
+ */
+
+#define NUM_THREADS	8
+#define NUM_ROUNDS	16
+
+
+/*
+ * Shared, read-only data.
+ */
+
+typedef struct {
+	unsigned char	*buf;
+	size_t		len;
+} BUFFER;
+
+static BUFFER	carrier;
+static BUFFER	golden;
+static BUFFER	message;
+
+static const char	*methods[] = {"huffman", "range", "cm", "dict", "auto"};
+
+
+/*
+ * Read a whole file into a buffer.
+ */
+
+static int
+buffer_load (
+	const char	*path,
+	BUFFER		*b
+) {
+	FILE		*fp;
+	size_t		n;
+
+	if ((fp = fopen (path, "rb")) == NULL) {
+	    perror (path);
+	    return (0);
+	}
+
+	b->len = 0;
+	b->buf = NULL;
+	do {
+	    b->buf = realloc (b->buf, b->len + 4096);
+	    n = fread (b->buf + b->len, 1, 4096, fp);
+	    b->len += n;
+	} while (n > 0);
+
+	fclose (fp);
+	return (1);
+}
+
+
+/*
+ * Conceal a message and extract it again, either with the handle or
+ * with the one-shot calls.
+ */
+
+static int
+roundtrip (
+	GIFSHUFFLE			*gs,
+	const GIFSHUFFLE_OPTIONS	*opts,
+	const char			*msg
+) {
+	unsigned char			*out, *ext;
+	size_t				out_len, ext_len;
+	size_t				len = strlen (msg);
+	int				ok;
+
+	if (gs != NULL)
+	    ok = gifshuffle_embed_with (gs, carrier.buf, carrier.len,
+			(const unsigned char *) msg, len, &out, &out_len);
+	else
+	    ok = gifshuffle_embed (carrier.buf, carrier.len,
+			(const unsigned char *) msg, len, opts,
+			&out, &out_len);
+	if (!ok)
+	    return (0);
+
+	if (gs != NULL)
+	    ok = gifshuffle_extract_with (gs, out, out_len, &ext, &ext_len);
+	else
+	    ok = gifshuffle_extract (out, out_len, opts, &ext, &ext_len);
+	gifshuffle_free (out);
+	if (!ok)
+	    return (0);
+
+	ok = (ext_len == len && memcmp (ext, msg, len) == 0);
+	gifshuffle_free (ext);
+
+	return (ok);
+}
+
+
+/*
+ * Conceal the golden message, and compare it with the golden file.
+ */
+
+static int
+golden_check (
+	GIFSHUFFLE	*gs
+) {
+	unsigned char	*out;
+	size_t		out_len;
+	int		ok;
+
+	if (!gifshuffle_embed_with (gs, carrier.buf, carrier.len,
+				message.buf, message.len, &out, &out_len))
+	    return (0);
+
+	ok = (out_len == golden.len && memcmp (out, golden.buf, out_len) == 0);
+	gifshuffle_free (out);
+
+	return (ok);
+}
+
+
+/*
+ * Extract from the golden file with a handle for another password,
+ * which must not give the golden message, whatever the handle has
+ * cached for the carrier.
+ */
+
+static int
+stranger_check (
+	GIFSHUFFLE	*gs
+) {
+	unsigned char	*ext;
+	size_t		ext_len;
+	int		ok;
+
+	if (!gifshuffle_extract_with (gs, golden.buf, golden.len,
+							&ext, &ext_len))
+	    return (1);
+
+	ok = (ext_len != message.len
+			|| memcmp (ext, message.buf, ext_len) != 0);
+	gifshuffle_free (ext);
+
+	return (ok);
+}
+
+
+/*
+ * The body of each thread. Returns the number of failures.
+ */
+
+static void *
+thread_run (
+	void			*arg
+) {
+	long			id = (long) arg;
+	long			failures = 0;
+	GIFSHUFFLE_OPTIONS	opts, gopts;
+	GIFSHUFFLE		*gs, *ggs, *sgs;
+	char			msg[64], passwd[16];
+	int			i;
+
+	memset (&gopts, 0, sizeof (gopts));
+	gopts.gso_password = "hello";
+	if ((ggs = gifshuffle_open (&gopts)) == NULL)
+	    return ((void *) (long) NUM_ROUNDS);
+
+	sprintf (passwd, "pw%ld", id % 5);
+	gopts.gso_password = passwd;
+	if ((sgs = gifshuffle_open (&gopts)) == NULL) {
+	    gifshuffle_close (ggs);
+	    return ((void *) (long) NUM_ROUNDS);
+	}
+
+	for (i = 0; i < NUM_ROUNDS; i++) {
+	    memset (&opts, 0, sizeof (opts));
+	    sprintf (passwd, "pw%ld", (id + i) % 5);
+	    opts.gso_password = passwd;
+	    opts.gso_method = methods[(id + i) % 5];
+	    if (strcmp (opts.gso_method, "dict") == 0)
+		opts.gso_dict = "json";
+	    opts.gso_header = i & 1;
+	    opts.gso_block = (i >> 1) & 1;
+	    opts.gso_group = (i >> 2) & 1;
+	    opts.gso_fixed_key = (i >> 3) & 1;
+
+	    sprintf (msg, "thread %ld round %d {\"id\": %d}", id, i, i * 7);
+
+	    if ((gs = gifshuffle_open (&opts)) == NULL) {
+		failures++;
+		continue;
+	    }
+	    if (!roundtrip (gs, &opts, msg) || !roundtrip (gs, &opts, msg))
+		failures++;
+	    gifshuffle_close (gs);
+
+	    if (!roundtrip (NULL, &opts, msg))
+		failures++;
+	    if (!golden_check (ggs) || !stranger_check (sgs))
+		failures++;
+	}
+
+	gifshuffle_close (ggs);
+	gifshuffle_close (sgs);
+	return ((void *) failures);
+}
+
+
+/*
+ * Program's starting point.
+ */
+
+int
+main (
+	int		argc,
+	char		*argv[]
+) {
+	pthread_t	threads[NUM_THREADS];
+	void		*res;
+	long		failures = 0;
+	long		i;
+
+	if (argc != 4) {
+	    fprintf (stderr, "Usage: %s carrier.gif golden.gif message\n",
+								argv[0]);
+	    return (1);
+	}
+
+	if (!buffer_load (argv[1], &carrier) || !buffer_load (argv[2], &golden)
+				|| !buffer_load (argv[3], &message))
+	    return (1);
+
+	for (i = 0; i < NUM_THREADS; i++)
+	    if (pthread_create (&threads[i], NULL, thread_run,
+							(void *) i) != 0) {
+		fprintf (stderr, "Could not create thread.\n");
+		return (1);
+	    }
+
+	for (i = 0; i < NUM_THREADS; i++) {
+	    pthread_join (threads[i], &res);
+	    failures += (long) res;
+	}
+
+	free (carrier.buf);
+	free (golden.buf);
+	free (message.buf);
+
+	if (failures != 0) {
+	    fprintf (stderr, "%ld library tests failed.\n", failures);
+	    return (1);
+	}
+
+	return (0);
+}